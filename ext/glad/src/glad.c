@@ -7,15 +7,17 @@
     APIs: gl=3.3
     Profile: compatibility
     Extensions:
+        GL_ARB_get_program_binary
         GL_KHR_debug
+        GL_KHR_parallel_shader_compile
     Loader: True
     Local files: False
     Omit khrplatform: False
 
     Commandline:
-        --profile="compatibility" --api="gl=3.3" --generator="c" --spec="gl" --extensions="GL_KHR_debug"
+        --profile="compatibility" --api="gl=3.3" --generator="c" --spec="gl" --extensions="GL_ARB_get_program_binary,GL_KHR_debug,GL_KHR_parallel_shader_compile"
     Online:
-        http://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D3.3&extensions=GL_KHR_debug
+        http://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D3.3&extensions=GL_ARB_get_program_binary&extensions=GL_KHR_debug&extensions=GL_KHR_parallel_shader_compile
 */
 
 #include <stdio.h>
@@ -956,7 +958,11 @@ PFNGLCOLORPOINTERPROC glad_glColorPointer;
 PFNGLFRONTFACEPROC glad_glFrontFace;
 PFNGLGETBOOLEANI_VPROC glad_glGetBooleani_v;
 PFNGLCLEARBUFFERUIVPROC glad_glClearBufferuiv;
+int GLAD_GL_ARB_get_program_binary;
 int GLAD_GL_KHR_debug;
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary;
+PFNGLPROGRAMBINARYPROC glad_glProgramBinary;
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri;
 PFNGLDEBUGMESSAGECONTROLPROC glad_glDebugMessageControl;
 PFNGLDEBUGMESSAGEINSERTPROC glad_glDebugMessageInsert;
 PFNGLDEBUGMESSAGECALLBACKPROC glad_glDebugMessageCallback;
@@ -978,6 +984,8 @@ PFNGLGETOBJECTLABELKHRPROC glad_glGetObjectLabelKHR;
 PFNGLOBJECTPTRLABELKHRPROC glad_glObjectPtrLabelKHR;
 PFNGLGETOBJECTPTRLABELKHRPROC glad_glGetObjectPtrLabelKHR;
 PFNGLGETPOINTERVKHRPROC glad_glGetPointervKHR;
+int GLAD_GL_KHR_parallel_shader_compile;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR;
 static void load_GL_VERSION_1_0(GLADloadproc load) {
 	if(!GLAD_GL_VERSION_1_0) return;
 	glad_glCullFace = (PFNGLCULLFACEPROC)load("glCullFace");
@@ -1741,6 +1749,12 @@ static void load_GL_VERSION_3_3(GLADloadproc load) {
 	glad_glSecondaryColorP3ui = (PFNGLSECONDARYCOLORP3UIPROC)load("glSecondaryColorP3ui");
 	glad_glSecondaryColorP3uiv = (PFNGLSECONDARYCOLORP3UIVPROC)load("glSecondaryColorP3uiv");
 }
+static void load_GL_ARB_get_program_binary(GLADloadproc load) {
+	if(!GLAD_GL_ARB_get_program_binary) return;
+	glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+	glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+	glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+}
 static void load_GL_KHR_debug(GLADloadproc load) {
 	if(!GLAD_GL_KHR_debug) return;
 	glad_glDebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)load("glDebugMessageControl");
@@ -1766,9 +1780,15 @@ static void load_GL_KHR_debug(GLADloadproc load) {
 	glad_glGetObjectPtrLabelKHR = (PFNGLGETOBJECTPTRLABELKHRPROC)load("glGetObjectPtrLabelKHR");
 	glad_glGetPointervKHR = (PFNGLGETPOINTERVKHRPROC)load("glGetPointervKHR");
 }
+static void load_GL_KHR_parallel_shader_compile(GLADloadproc load) {
+	if(!GLAD_GL_KHR_parallel_shader_compile) return;
+	glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+}
 static int find_extensionsGL(void) {
 	if (!get_exts()) return 0;
+	GLAD_GL_ARB_get_program_binary = has_ext("GL_ARB_get_program_binary");
 	GLAD_GL_KHR_debug = has_ext("GL_KHR_debug");
+	GLAD_GL_KHR_parallel_shader_compile = has_ext("GL_KHR_parallel_shader_compile");
 	free_exts();
 	return 1;
 }
@@ -1847,7 +1867,9 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_VERSION_3_3(load);
 
 	if (!find_extensionsGL()) return 0;
+	load_GL_ARB_get_program_binary(load);
 	load_GL_KHR_debug(load);
+	load_GL_KHR_parallel_shader_compile(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
@@ -3,10 +3,14 @@ layout (location = 0) in vec3 vertPos;
 
 out vec3 TexCoords;
 
-uniform mat4 P;
+layout(std140) uniform Frame
+{
+	mat4 P;
+	mat4 view;
+	vec4 eyePos;
+};
 uniform mat4 V;
 uniform mat4 M;
-uniform mat4 view;
 
 void main() {
 	TexCoords = vertPos;
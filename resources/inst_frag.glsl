@@ -0,0 +1,22 @@
+#version 330 core 
+in vec3 fragNor;
+in vec3 WPos;
+flat in int fragMaterial;
+//to send the color to a frame buffer
+layout(location = 0) out vec4 color;
+
+layout(std140) uniform Materials
+{
+	vec4 MatAmb[4];
+	vec4 MatDif[4];
+};
+
+/* Very simple Diffuse shader with a directional light*/
+void main()
+{
+	vec3 Dcolor;
+	vec3 Dlight = vec3(1, 1, 1);
+	vec3 normal = normalize(fragNor);
+	Dcolor = MatDif[fragMaterial].rgb*max(dot(normalize(Dlight), normal), 0)+MatAmb[fragMaterial].rgb;
+	color = vec4(Dcolor, 1.0);
+}
@@ -0,0 +1,22 @@
+#version  330 core
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec3 vertNor;
+layout(location = 3) in mat4 instModel;
+layout(location = 7) in int instMaterial;
+layout(std140) uniform Frame
+{
+	mat4 P;
+	mat4 view;
+	vec4 eyePos;
+};
+out vec3 fragNor;
+out vec3 WPos;
+flat out int fragMaterial;
+
+void main()
+{
+	gl_Position = P * view * instModel * vertPos;
+	fragNor = (instModel * vec4(vertNor, 0.0)).xyz;
+	WPos = vec3(instModel*vertPos);
+	fragMaterial = instMaterial;
+}
@@ -4,8 +4,12 @@ in vec3 WPos;
 //to send the color to a frame buffer
 layout(location = 0) out vec4 color;
 
-uniform vec3 MatAmb;
-uniform vec3 MatDif;
+layout(std140) uniform Materials
+{
+	vec4 MatAmb[4];
+	vec4 MatDif[4];
+};
+uniform int material;
 
 /* Very simple Diffuse shader with a directional light*/
 void main()
@@ -13,6 +17,6 @@ void main()
 	vec3 Dcolor, Scolor;
    vec3 Dlight = vec3(1, 1, 1);
 	vec3 normal = normalize(fragNor);
-	Dcolor = MatDif*max(dot(normalize(Dlight), normal), 0)+MatAmb;
+	Dcolor = MatDif[material].rgb*max(dot(normalize(Dlight), normal), 0)+MatAmb[material].rgb;
 	color = vec4(Dcolor, 1.0);
 }
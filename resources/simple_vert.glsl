@@ -1,9 +1,13 @@
 #version  330 core
 layout(location = 0) in vec4 vertPos;
 layout(location = 1) in vec3 vertNor;
-uniform mat4 P;
+layout(std140) uniform Frame
+{
+	mat4 P;
+	mat4 view;
+	vec4 eyePos;
+};
 uniform mat4 MV;
-uniform mat4 view;
 out vec3 fragNor;
 out vec3 WPos;
 
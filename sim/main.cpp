@@ -0,0 +1,116 @@
+/*
+ Headless run of the game logic in Simulation, to time it without a window
+ or GL context: N targets and M balls that are thrown over and over, for K
+ steps of one tick (1/60 s). Prints the steps per second, and with
+ --min-rate fails when they drop below it, so that a CI job can catch
+ slowdowns.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Simulation.h"
+
+using namespace std;
+using namespace glm;
+
+
+int main(int argc, char **argv)
+{
+    size_t targets = 20;
+    size_t balls = 1;
+    size_t ticks = 100000;
+    double minRate = 0;
+    unsigned int seed = 1;
+    
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--targets" && i + 1 < argc)
+        {
+            targets = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--balls" && i + 1 < argc)
+        {
+            balls = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--ticks" && i + 1 < argc)
+        {
+            ticks = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--min-rate" && i + 1 < argc)
+        {
+            minRate = atof(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = (unsigned int) atoi(argv[++i]);
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--targets N] [--balls M] [--ticks K]"
+                << " [--min-rate TICKS_PER_SECOND] [--seed S]" << endl;
+            return 2;
+        }
+    }
+    
+    srand(seed);
+    Simulation sim;
+    sim.reset(targets, balls);
+    
+    // Every ball is charged for a random number of steps, thrown in a random
+    // direction the way the camera can look, and charged again once it is back
+    vector<int> charge(balls, 0);
+    size_t throws = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < ticks; t++)
+    {
+        for (size_t b = 0; b < balls; b++)
+        {
+            Simulation::Ball &ball = sim.balls[b];
+            ball.landed = false;
+            if (ball.charging)
+            {
+                ball.charging = --charge[b] > 0;
+            }
+            else if (ball.speed == 0)
+            {
+                float theta = (rand() % 628) / 100.0f;
+                float phi = (rand() % 187 - 93) / 100.0f;
+                ball.aim = vec3(cos(phi) * cos(theta), sin(phi), cos(phi) * sin(theta));
+                ball.charging = true;
+                charge[b] = 30 + rand() % 60;
+                throws++;
+            }
+        }
+        sim.step(1.0 / Simulation::TickRate);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    // Depends on every step, so none of them can be optimized away, and
+    // should not change between two runs with the same options
+    double checksum = 0;
+    for (size_t i = 0; i < targets; i++)
+    {
+        checksum += sim.hit[i] + sim.explosion[i];
+    }
+    
+    const double rate = ticks / seconds;
+    cout << "Simulated " << targets << " targets and " << balls << " balls for " << sim.ticks
+        << " ticks in " << seconds << " s: " << rate << " ticks/s, "
+        << seconds * 1e9 / ticks << " ns per tick (" << throws << " throws, checksum "
+        << checksum << ")" << endl;
+    
+    if (rate < minRate)
+    {
+        cerr << "Below the minimum of " << minRate << " ticks/s" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+static int64_t modificationTime(const string &fileName)
+{
+	struct stat sb;
+	if (stat(fileName.c_str(), &sb) != 0)
+	{
+		return 0;
+	}
+	return (int64_t) sb.st_mtime;
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (inotifyFD >= 0)
+	{
+		close(inotifyFD);
+	}
+#endif
+}
+
+void FileWatcher::add(const string &fileName)
+{
+	File file;
+	file.name = fileName;
+	const size_t slash = fileName.find_last_of("/\\");
+	const string dir = slash == string::npos ? "." : fileName.substr(0, slash);
+	file.base = slash == string::npos ? fileName : fileName.substr(slash + 1);
+	file.mtime = modificationTime(fileName);
+
+#ifdef __linux__
+	if (inotifyFD < 0)
+	{
+		inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	}
+	if (inotifyFD >= 0)
+	{
+		// Watching the same directory again hands out the same descriptor
+		file.watch = inotify_add_watch(inotifyFD, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	}
+#endif
+
+	files.push_back(file);
+}
+
+vector<string> FileWatcher::poll()
+{
+	vector<string> changed;
+	auto report = [&changed](const File &file)
+	{
+		if (find(changed.begin(), changed.end(), file.name) == changed.end())
+		{
+			changed.push_back(file.name);
+		}
+	};
+
+#ifdef __linux__
+	if (inotifyFD >= 0)
+	{
+		alignas(struct inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyFD, buffer, sizeof(buffer))) > 0)
+		{
+			for (ssize_t offset = 0; offset < length; )
+			{
+				const struct inotify_event *event = (const struct inotify_event *) (buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+				if (event->len == 0)
+				{
+					continue;
+				}
+				for (const File &file : files)
+				{
+					if (file.watch == event->wd && file.base == event->name)
+					{
+						report(file);
+					}
+				}
+			}
+		}
+	}
+#endif
+
+	for (File &file : files)
+	{
+		if (file.watch < 0)
+		{
+			const int64_t mtime = modificationTime(file.name);
+			if (mtime != file.mtime)
+			{
+				file.mtime = mtime;
+				report(file);
+			}
+		}
+	}
+
+	return changed;
+}
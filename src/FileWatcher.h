@@ -0,0 +1,49 @@
+#pragma once
+#ifndef LAB471_FILEWATCHER_H_INCLUDED
+#define LAB471_FILEWATCHER_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Tells which of a set of files were written to since it was last asked.
+//
+// On Linux this is inotify on the directories of the files, which also sees
+// editors that save by writing a new file and renaming it over the old one.
+// Elsewhere, or if inotify is not available, poll() compares modification
+// times.
+class FileWatcher
+{
+
+public:
+
+	FileWatcher() {}
+	~FileWatcher();
+
+	// Owns the inotify descriptor, so it cannot be copied
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator= (const FileWatcher&) = delete;
+
+	void add(const std::string &fileName);
+
+	// The files that changed since the last call, each named once and the
+	// way it was passed to add(). Never blocks.
+	std::vector<std::string> poll();
+
+private:
+
+	struct File
+	{
+		std::string name;
+		std::string base;
+		int watch = -1;
+		int64_t mtime = 0;
+	};
+
+	std::vector<File> files;
+	int inotifyFD = -1;
+
+};
+
+#endif // LAB471_FILEWATCHER_H_INCLUDED
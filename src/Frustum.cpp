@@ -0,0 +1,110 @@
+#include "Frustum.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+
+void Frustum::Spheres::clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+}
+
+void Frustum::Spheres::add(const vec3 &center, float r)
+{
+	x.push_back(center.x);
+	y.push_back(center.y);
+	z.push_back(center.z);
+	radius.push_back(r);
+}
+
+void Frustum::Spheres::set(size_t i, const vec3 &center, float r)
+{
+	x[i] = center.x;
+	y[i] = center.y;
+	z[i] = center.z;
+	radius[i] = r;
+}
+
+void Frustum::extract(const mat4 &viewProj)
+{
+	// glm is column major, so row i is viewProj[0..3][i]
+	vec4 row[4];
+	for (int i = 0; i < 4; i++)
+	{
+		row[i] = vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	planes[0] = row[3] + row[0];	// left
+	planes[1] = row[3] - row[0];	// right
+	planes[2] = row[3] + row[1];	// bottom
+	planes[3] = row[3] - row[1];	// top
+	planes[4] = row[3] + row[2];	// near
+	planes[5] = row[3] - row[2];	// far
+
+	for (vec4 &plane : planes)
+	{
+		plane /= length(vec3(plane));
+	}
+}
+
+bool Frustum::isVisible(const vec3 &center, float r) const
+{
+	for (const vec4 &plane : planes)
+	{
+		if (dot(vec3(plane), center) + plane.w < -r)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t Frustum::cull(const Spheres &spheres, vector<unsigned char> &visible) const
+{
+	const size_t count = spheres.size();
+	visible.resize(count);
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_SSE
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+		const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+		const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+		__m128 outside = _mm_setzero_ps();
+		for (const vec4 &plane : planes)
+		{
+			__m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_set1_ps(plane.w));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.y), y));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.z), z));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negRadius));
+		}
+
+		const int mask = ~_mm_movemask_ps(outside);
+		for (int k = 0; k < 4; k++)
+		{
+			visible[i + k] = (mask >> k) & 1;
+			visibleCount += visible[i + k];
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		visible[i] = isVisible(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef LAB471_FRUSTUM_H_INCLUDED
+#define LAB471_FRUSTUM_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// The view frustum as six planes, for dropping objects that cannot be seen
+// before any uniform or instance work is done for them.
+class Frustum
+{
+
+public:
+
+	// Bounding spheres in SoA layout, so that cull() can test four at a time
+	struct Spheres
+	{
+		std::vector<float> x, y, z, radius;
+
+		void clear();
+		void add(const glm::vec3 &center, float r);
+		void set(size_t i, const glm::vec3 &center, float r);
+		size_t size() const { return x.size(); }
+	};
+
+	// Planes of the clip volume of viewProj (Gribb and Hartmann), so that the
+	// spheres are in whatever space viewProj transforms from
+	void extract(const glm::mat4 &viewProj);
+
+	bool isVisible(const glm::vec3 &center, float r) const;
+
+	// Sets visible[i] to 1 if sphere i touches the frustum and to 0 if it is
+	// entirely outside of a plane. Returns how many are visible.
+	size_t cull(const Spheres &spheres, std::vector<unsigned char> &visible) const;
+
+private:
+
+	// a*x + b*y + c*z + d >= 0 inside, with (a, b, c) normalized
+	glm::vec4 planes[6];
+
+};
+
+#endif // LAB471_FRUSTUM_H_INCLUDED
@@ -0,0 +1,138 @@
+#include "GLCallCounter.h"
+
+#include <glad/glad.h>
+
+
+namespace GLCallCounter
+{
+
+static size_t calls = 0;
+static bool installed = false;
+
+// Wraps the glad pointer in Slot: the original goes to real, the slot gets a
+// function with the same signature that counts and forwards
+template <typename Proc, Proc *Slot>
+struct Wrapper;
+
+template <typename R, typename... Args, R (APIENTRY **Slot)(Args...)>
+struct Wrapper<R (APIENTRY *)(Args...), Slot>
+{
+	static R (APIENTRY *real)(Args...);
+
+	static R APIENTRY call(Args... args)
+	{
+		calls++;
+		return real(args...);
+	}
+
+	static void install()
+	{
+		if (*Slot)
+		{
+			real = *Slot;
+			*Slot = &call;
+		}
+	}
+};
+
+template <typename R, typename... Args, R (APIENTRY **Slot)(Args...)>
+R (APIENTRY *Wrapper<R (APIENTRY *)(Args...), Slot>::real)(Args...) = nullptr;
+
+// glFoo is a macro for the glad_glFoo pointer
+#define COUNT_GL_CALLS(name) Wrapper<decltype(name), &name>::install()
+
+void install()
+{
+	if (installed)
+	{
+		return;
+	}
+	installed = true;
+
+	COUNT_GL_CALLS(glActiveTexture);
+	COUNT_GL_CALLS(glAttachShader);
+	COUNT_GL_CALLS(glBindAttribLocation);
+	COUNT_GL_CALLS(glBindBuffer);
+	COUNT_GL_CALLS(glBindBufferBase);
+	COUNT_GL_CALLS(glBindFramebuffer);
+	COUNT_GL_CALLS(glBindRenderbuffer);
+	COUNT_GL_CALLS(glBindTexture);
+	COUNT_GL_CALLS(glBindVertexArray);
+	COUNT_GL_CALLS(glBufferData);
+	COUNT_GL_CALLS(glBufferSubData);
+	COUNT_GL_CALLS(glCheckFramebufferStatus);
+	COUNT_GL_CALLS(glClear);
+	COUNT_GL_CALLS(glClearColor);
+	COUNT_GL_CALLS(glCompileShader);
+	COUNT_GL_CALLS(glCreateProgram);
+	COUNT_GL_CALLS(glCreateShader);
+	COUNT_GL_CALLS(glDeleteBuffers);
+	COUNT_GL_CALLS(glDeleteProgram);
+	COUNT_GL_CALLS(glDeleteShader);
+	COUNT_GL_CALLS(glDeleteVertexArrays);
+	COUNT_GL_CALLS(glDepthFunc);
+	COUNT_GL_CALLS(glDetachShader);
+	COUNT_GL_CALLS(glDisableVertexAttribArray);
+	COUNT_GL_CALLS(glDrawArrays);
+	COUNT_GL_CALLS(glDrawBuffers);
+	COUNT_GL_CALLS(glDrawElements);
+	COUNT_GL_CALLS(glDrawElementsInstanced);
+	COUNT_GL_CALLS(glDrawElementsInstancedBaseVertex);
+	COUNT_GL_CALLS(glEnable);
+	COUNT_GL_CALLS(glEnableVertexAttribArray);
+	COUNT_GL_CALLS(glFramebufferRenderbuffer);
+	COUNT_GL_CALLS(glFramebufferTexture2D);
+	COUNT_GL_CALLS(glGenBuffers);
+	COUNT_GL_CALLS(glGenFramebuffers);
+	COUNT_GL_CALLS(glGenRenderbuffers);
+	COUNT_GL_CALLS(glGenTextures);
+	COUNT_GL_CALLS(glGenVertexArrays);
+	COUNT_GL_CALLS(glGenerateMipmap);
+	COUNT_GL_CALLS(glGetAttribLocation);
+	COUNT_GL_CALLS(glGetError);
+	COUNT_GL_CALLS(glGetIntegerv);
+	COUNT_GL_CALLS(glGetProgramBinary);
+	COUNT_GL_CALLS(glGetProgramInfoLog);
+	COUNT_GL_CALLS(glGetProgramiv);
+	COUNT_GL_CALLS(glGetShaderInfoLog);
+	COUNT_GL_CALLS(glGetShaderiv);
+	COUNT_GL_CALLS(glGetString);
+	COUNT_GL_CALLS(glGetTexImage);
+	COUNT_GL_CALLS(glGetTexLevelParameteriv);
+	COUNT_GL_CALLS(glGetUniformBlockIndex);
+	COUNT_GL_CALLS(glGetUniformLocation);
+	COUNT_GL_CALLS(glLinkProgram);
+	COUNT_GL_CALLS(glMaxShaderCompilerThreadsKHR);
+	COUNT_GL_CALLS(glProgramBinary);
+	COUNT_GL_CALLS(glProgramParameteri);
+	COUNT_GL_CALLS(glRenderbufferStorage);
+	COUNT_GL_CALLS(glShaderSource);
+	COUNT_GL_CALLS(glTexImage2D);
+	COUNT_GL_CALLS(glTexParameteri);
+	COUNT_GL_CALLS(glUniform1i);
+	COUNT_GL_CALLS(glUniform2f);
+	COUNT_GL_CALLS(glUniformBlockBinding);
+	COUNT_GL_CALLS(glUniformMatrix4fv);
+	COUNT_GL_CALLS(glUseProgram);
+	COUNT_GL_CALLS(glVertexAttribDivisor);
+	COUNT_GL_CALLS(glVertexAttribIPointer);
+	COUNT_GL_CALLS(glVertexAttribPointer);
+	COUNT_GL_CALLS(glViewport);
+}
+
+bool isInstalled()
+{
+	return installed;
+}
+
+size_t count()
+{
+	return calls;
+}
+
+void reset()
+{
+	calls = 0;
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+#ifndef LAB471_GLCALLCOUNTER_H_INCLUDED
+#define LAB471_GLCALLCOUNTER_H_INCLUDED
+
+#include <cstddef>
+
+
+// Counts the GL calls the app issues, to check how much a frame costs in
+// driver calls. install() has to run after gladLoadGL(); it swaps the glad
+// function pointers of every GL entry point the app uses for counting
+// wrappers, so nothing is counted (or slowed down) unless it is called.
+namespace GLCallCounter
+{
+	void install();
+	bool isInstalled();
+
+	// Calls since the last reset()
+	size_t count();
+	void reset();
+}
+
+#endif // LAB471_GLCALLCOUNTER_H_INCLUDED
@@ -14,6 +14,10 @@
 namespace GLSL
 {
 
+// On until the first beginFrame() in the sampled mode, so that startup
+// (shader compiles, program binaries, buffer creation) is always checked
+bool checkErrors = true;
+
 const char * errorString(GLenum err)
 {
 	switch (err) {
@@ -167,4 +171,45 @@ void vertexAttribPointer(const GLint handle, GLint size, GLenum type, GLboolean
 	}
 }
 
+#ifdef OPENGL_ERROR_CHECKS_DEBUG
+static void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar *message, const void *userParam)
+{
+	if (severity != GL_DEBUG_SEVERITY_NOTIFICATION)
+	{
+		printf("OpenGL debug message (type 0x%X, id %u, severity 0x%X): %s\n", type, id, severity, message);
+	}
+}
+#endif
+
+void initErrorReporting()
+{
+#if defined(OPENGL_ERROR_CHECKS_DEBUG)
+	if (GLAD_GL_KHR_debug && glDebugMessageCallback)
+	{
+		// Asynchronous: the driver does not have to stall on every call, at
+		// the price of messages possibly arriving after the call caused them
+		glEnable(GL_DEBUG_OUTPUT);
+		glDebugMessageCallback(debugCallback, nullptr);
+		checkErrors = false;
+		printf("OpenGL errors are reported through KHR_debug\n");
+	}
+	else
+	{
+		checkErrors = true;
+		printf("KHR_debug is not available, checking every GL call for errors\n");
+	}
+#elif defined(OPENGL_ERROR_CHECKS_SAMPLED)
+	printf("Checking GL calls for errors during startup and every %d frames\n", OPENGL_ERROR_CHECK_INTERVAL);
+#endif
+}
+
+void beginFrame()
+{
+#ifdef OPENGL_ERROR_CHECKS_SAMPLED
+	static unsigned int frame = 0;
+	checkErrors = frame++ % OPENGL_ERROR_CHECK_INTERVAL == 0;
+#endif
+}
+
 }
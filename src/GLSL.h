@@ -14,6 +14,17 @@
 
 namespace GLSL
 {
+	// Attribute locations every shader uses, so that a VAO set up once works
+	// with any program. An instModel mat4 takes four locations.
+	const GLuint VertPosLocation = 0;
+	const GLuint VertNorLocation = 1;
+	const GLuint VertTexLocation = 2;
+	const GLuint InstModelLocation = 3;
+	const GLuint InstMaterialLocation = 7;
+
+	// Binding points of the uniform blocks shared by all programs
+	const GLuint FrameBlockBinding = 0;
+	const GLuint MaterialBlockBinding = 1;
 
 	void printOpenGLErrors(char const * const Function, char const * const File, int const Line);
 	void checkError(const char *str = 0);
@@ -25,13 +36,38 @@ namespace GLSL
 	void enableVertexAttribArray(const GLint handle);
 	void disableVertexAttribArray(const GLint handle);
 	void vertexAttribPointer(const GLint handle, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+
+	// Whether CHECKED_GL_CALL calls glGetError right now, in the sampled and
+	// debug modes
+	extern bool checkErrors;
+
+	// Sets up error reporting for the build's mode, once there is a context
+	void initErrorReporting();
+	// Call at the start of every frame, picks the frames that are checked
+	void beginFrame();
 }
 
 
-#ifndef DISABLE_OPENGL_ERROR_CHECKS
-#define CHECKED_GL_CALL(x) do { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
-#else
+// How CHECKED_GL_CALL looks for errors is picked by the build (see the
+// GL_ERROR_CHECKS option in CMakeLists.txt):
+//   DISABLE_OPENGL_ERROR_CHECKS  no checks, the call is all that is left
+//   OPENGL_ERROR_CHECKS_SAMPLED  glGetError around every call, but only in
+//                                one frame out of OPENGL_ERROR_CHECK_INTERVAL
+//                                and before the first frame
+//   OPENGL_ERROR_CHECKS_DEBUG    the driver reports errors to a KHR_debug
+//                                callback as they happen; without the
+//                                extension every call is checked
+//   (none of these)              glGetError before and after every call
+#if defined(DISABLE_OPENGL_ERROR_CHECKS)
 #define CHECKED_GL_CALL(x) (x)
+#elif defined(OPENGL_ERROR_CHECKS_SAMPLED) || defined(OPENGL_ERROR_CHECKS_DEBUG)
+#define CHECKED_GL_CALL(x) do { if (GLSL::checkErrors) { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); } (x); if (GLSL::checkErrors) { GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } } while (0)
+#else
+#define CHECKED_GL_CALL(x) do { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
+#endif
+
+#ifndef OPENGL_ERROR_CHECK_INTERVAL
+#define OPENGL_ERROR_CHECK_INTERVAL 60
 #endif
 
 #endif // LAB471_GLSL_H_INCLUDED
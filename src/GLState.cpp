@@ -0,0 +1,229 @@
+#include "GLState.h"
+
+
+namespace GLState
+{
+
+// Marks a binding that is not known, so the next bind is always issued
+static const GLuint Unknown = 0xffffffff;
+static const int MaxTextureUnits = 16;
+
+static GLuint program = Unknown;
+static GLuint vertexArray = Unknown;
+static GLuint arrayBuffer = Unknown;
+static GLuint elementBuffer = Unknown;
+static GLuint uniformBuffer = Unknown;
+static int activeUnit = -1;
+static GLuint textures2D[MaxTextureUnits];
+static GLuint texturesCube[MaxTextureUnits];
+static bool texturesKnown = false;
+static Stats stats;
+
+// Records binding = value, returns true if GL has to be told
+static bool change(GLuint &binding, GLuint value)
+{
+	if (binding == value)
+	{
+		stats.elided++;
+		return false;
+	}
+	binding = value;
+	stats.issued++;
+	return true;
+}
+
+static GLuint *bufferBinding(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return &arrayBuffer;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return &elementBuffer;
+	case GL_UNIFORM_BUFFER:
+		return &uniformBuffer;
+	default:
+		return nullptr;
+	}
+}
+
+static GLuint *textureBinding(GLenum target)
+{
+	if (!texturesKnown)
+	{
+		for (int i = 0; i < MaxTextureUnits; i++)
+		{
+			textures2D[i] = texturesCube[i] = Unknown;
+		}
+		texturesKnown = true;
+	}
+	if (activeUnit < 0 || activeUnit >= MaxTextureUnits)
+	{
+		return nullptr;
+	}
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return &textures2D[activeUnit];
+	case GL_TEXTURE_CUBE_MAP:
+		return &texturesCube[activeUnit];
+	default:
+		return nullptr;
+	}
+}
+
+void useProgram(GLuint id)
+{
+	if (change(program, id))
+	{
+		glUseProgram(id);
+	}
+}
+
+void bindVertexArray(GLuint vao)
+{
+	if (change(vertexArray, vao))
+	{
+		glBindVertexArray(vao);
+		// The element buffer binding belongs to the VAO
+		elementBuffer = Unknown;
+	}
+}
+
+void bindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint *binding = bufferBinding(target);
+	if (!binding)
+	{
+		stats.issued++;
+		glBindBuffer(target, buffer);
+	}
+	else if (change(*binding, buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	stats.issued++;
+	glBindBufferBase(target, index, buffer);
+
+	GLuint *binding = bufferBinding(target);
+	if (binding)
+	{
+		*binding = buffer;
+	}
+}
+
+void activeTexture(GLenum unit)
+{
+	const int index = (int) (unit - GL_TEXTURE0);
+	if (index == activeUnit)
+	{
+		stats.elided++;
+		return;
+	}
+	activeUnit = index;
+	stats.issued++;
+	glActiveTexture(unit);
+}
+
+void bindTexture(GLenum target, GLuint texture)
+{
+	if (activeUnit < 0)
+	{
+		// The active unit is not known yet, GL starts out on unit 0
+		activeTexture(GL_TEXTURE0);
+	}
+
+	GLuint *binding = textureBinding(target);
+	if (!binding)
+	{
+		stats.issued++;
+		glBindTexture(target, texture);
+	}
+	else if (change(*binding, texture))
+	{
+		glBindTexture(target, texture);
+	}
+}
+
+void deleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		GLuint *bindings[] = {&arrayBuffer, &elementBuffer, &uniformBuffer};
+		for (GLuint *binding : bindings)
+		{
+			if (*binding == buffers[i])
+			{
+				*binding = 0;
+			}
+		}
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+void deleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (vertexArray == arrays[i])
+		{
+			vertexArray = 0;
+			elementBuffer = Unknown;
+		}
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+void deleteProgram(GLuint id)
+{
+	// A current program is only flagged for deletion and stays in use
+	if (program == id)
+	{
+		program = Unknown;
+	}
+	glDeleteProgram(id);
+}
+
+void deleteTextures(GLsizei n, const GLuint *textures)
+{
+	for (GLsizei i = 0; texturesKnown && i < n; i++)
+	{
+		// Every unit the texture is bound to goes back to texture 0
+		for (int u = 0; u < MaxTextureUnits; u++)
+		{
+			if (textures2D[u] == textures[i])
+			{
+				textures2D[u] = 0;
+			}
+			if (texturesCube[u] == textures[i])
+			{
+				texturesCube[u] = 0;
+			}
+		}
+	}
+	glDeleteTextures(n, textures);
+}
+
+void invalidate()
+{
+	program = vertexArray = Unknown;
+	arrayBuffer = elementBuffer = uniformBuffer = Unknown;
+	activeUnit = -1;
+	texturesKnown = false;
+}
+
+const Stats &getStats()
+{
+	return stats;
+}
+
+void resetStats()
+{
+	stats = Stats();
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef LAB471_GLSTATE_H_INCLUDED
+#define LAB471_GLSTATE_H_INCLUDED
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+
+// Shadow copy of the GL bindings the app changes most often: the current
+// program, the vertex array, the array/element/uniform buffer bindings and
+// the 2D and cube map textures of every texture unit. A bind that would not
+// change anything is skipped.
+//
+// This only works if all of these bindings go through here. Code that binds
+// behind its back has to restore what it changed, or call invalidate().
+namespace GLState
+{
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	// Also sets the generic binding of target, like GL does
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void activeTexture(GLenum unit);
+	// Binds to the active texture unit
+	void bindTexture(GLenum target, GLuint texture);
+
+	// Deleting a bound object resets the binding to 0, these keep track
+	void deleteBuffers(GLsizei n, const GLuint *buffers);
+	void deleteVertexArrays(GLsizei n, const GLuint *arrays);
+	void deleteProgram(GLuint program);
+	// GL can hand out a deleted name again, which must not look bound
+	void deleteTextures(GLsizei n, const GLuint *textures);
+
+	// Forget everything, the next bind of anything is issued
+	void invalidate();
+
+	struct Stats
+	{
+		size_t issued = 0;
+		size_t elided = 0;
+	};
+
+	// Binds issued to and kept from the driver since the last reset
+	const Stats &getStats();
+	void resetStats();
+}
+
+#endif // LAB471_GLSTATE_H_INCLUDED
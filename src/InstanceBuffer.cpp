@@ -0,0 +1,67 @@
+#include "InstanceBuffer.h"
+
+#include <cstddef>
+
+#include "GLSL.h"
+#include "GLState.h"
+
+
+InstanceBuffer::~InstanceBuffer()
+{
+	if (bufID != 0)
+	{
+		GLState::deleteBuffers(1, &bufID);
+	}
+}
+
+void InstanceBuffer::upload()
+{
+	if (bufID == 0)
+	{
+		glGenBuffers(1, &bufID);
+	}
+	if (dirtyBegin == dirtyEnd)
+	{
+		return;
+	}
+
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufID);
+	// Grow in powers of two so that a changing instance count does not
+	// reallocate every frame
+	if (instances.size() > capacity)
+	{
+		capacity = capacity ? capacity : 64;
+		while (capacity < instances.size())
+		{
+			capacity *= 2;
+		}
+		dirtyBegin = 0;
+		dirtyEnd = instances.size();
+	}
+	if (dirtyBegin == 0 && dirtyEnd == instances.size())
+	{
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(Instance),
+		(dirtyEnd - dirtyBegin) * sizeof(Instance), instances.data() + dirtyBegin);
+	dirtyBegin = dirtyEnd = 0;
+}
+
+void InstanceBuffer::bindAttributes() const
+{
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufID);
+
+	// A mat4 takes four consecutive attribute slots, one per column
+	for (GLuint c = 0; c < 4; c++)
+	{
+		glEnableVertexAttribArray(GLSL::InstModelLocation + c);
+		glVertexAttribPointer(GLSL::InstModelLocation + c, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			(const void *) (offsetof(Instance, model) + c * sizeof(glm::vec4)));
+		glVertexAttribDivisor(GLSL::InstModelLocation + c, 1);
+	}
+
+	glEnableVertexAttribArray(GLSL::InstMaterialLocation);
+	glVertexAttribIPointer(GLSL::InstMaterialLocation, 1, GL_INT, sizeof(Instance),
+		(const void *) offsetof(Instance, material));
+	glVertexAttribDivisor(GLSL::InstMaterialLocation, 1);
+}
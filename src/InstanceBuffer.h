@@ -0,0 +1,79 @@
+#pragma once
+#ifndef LAB471_INSTANCEBUFFER_H_INCLUDED
+#define LAB471_INSTANCEBUFFER_H_INCLUDED
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// Per-instance data for Shape::drawInstanced(): a model matrix and a material
+// index for every instance, kept in one GL buffer. Instances that do not
+// change are not sent again; upload() only sends the range touched since the
+// last upload.
+//
+// The shader reads them as "instModel" (a mat4, i.e. four attribute slots)
+// and "instMaterial" (an int), at the locations in GLSL.h.
+class InstanceBuffer
+{
+
+public:
+
+	struct Instance
+	{
+		glm::mat4 model;
+		int material;
+	};
+
+	InstanceBuffer() {}
+	~InstanceBuffer();
+
+	// Owns a GL buffer, so it cannot be copied
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator= (const InstanceBuffer&) = delete;
+
+	void clear() { instances.clear(); dirtyBegin = dirtyEnd = 0; }
+	void add(const glm::mat4 &model, int material)
+	{
+		instances.push_back({model, material});
+		markDirty(instances.size() - 1);
+	}
+	void setModel(size_t i, const glm::mat4 &model)
+	{
+		instances[i].model = model;
+		markDirty(i);
+	}
+	size_t size() const { return instances.size(); }
+	const Instance &operator[] (size_t i) const { return instances[i]; }
+
+	// Sends the instances changed since the last upload to the GPU. When all
+	// of them changed, the old storage is orphaned first, so the driver does
+	// not have to wait for draws that still read it.
+	void upload();
+
+	// 0 until the first upload(); stays the same afterwards
+	unsigned int getBufferID() const { return bufID; }
+
+	// Points the instance attributes at the buffer (divisor 1), in the
+	// currently bound VAO
+	void bindAttributes() const;
+
+private:
+
+	void markDirty(size_t i)
+	{
+		dirtyBegin = dirtyBegin == dirtyEnd ? i : std::min(dirtyBegin, i);
+		dirtyEnd = std::max(dirtyEnd, i + 1);
+	}
+
+	std::vector<Instance> instances;
+	unsigned int bufID = 0;
+	size_t capacity = 0;
+
+	// Instances not uploaded yet; empty if both are equal
+	size_t dirtyBegin = 0, dirtyEnd = 0;
+
+};
+
+#endif // LAB471_INSTANCEBUFFER_H_INCLUDED
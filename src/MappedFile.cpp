@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &fileName)
+{
+	close();
+
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+	{
+		return false;
+	}
+
+	mapData = static_cast<const char *>(view);
+	mapSize = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapData)
+	{
+		UnmapViewOfFile(mapData);
+	}
+	mapData = nullptr;
+	mapSize = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &fileName)
+{
+	close();
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 || sb.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *addr = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED)
+	{
+		return false;
+	}
+
+	mapData = static_cast<const char *>(addr);
+	mapSize = (size_t) sb.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapData)
+	{
+		munmap(const_cast<char *>(mapData), mapSize);
+	}
+	mapData = nullptr;
+	mapSize = 0;
+}
+
+#endif
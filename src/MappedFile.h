@@ -0,0 +1,35 @@
+#pragma once
+#ifndef LAB471_MAPPEDFILE_H_INCLUDED
+#define LAB471_MAPPEDFILE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+
+// Read-only memory mapping of a whole file (mmap, or MapViewOfFile on Windows)
+class MappedFile
+{
+
+public:
+
+	MappedFile() {}
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator= (const MappedFile&) = delete;
+
+	// Maps the file. Returns false if it does not exist or cannot be mapped.
+	bool open(const std::string &fileName);
+	void close();
+
+	const char *data() const { return mapData; }
+	size_t size() const { return mapSize; }
+
+private:
+
+	const char *mapData = nullptr;
+	size_t mapSize = 0;
+
+};
+
+#endif // LAB471_MAPPEDFILE_H_INCLUDED
@@ -1,74 +1,102 @@
 
 #include "MatrixStack.h"
+#include <cmath>
+#include <cstdio>
 #include <glm/gtc/matrix_transform.hpp>
 
-static const int MaxMatrixSize = 100;
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIXSTACK_SSE
+#include <xmmintrin.h>
+#endif
 
 
-MatrixStack::MatrixStack()
+// translate, scale and rotate only touch the columns of the top matrix that
+// change, and only with the terms of the transform that are not 0 or 1:
+// translate is 12 multiply-adds instead of a 64 multiply 4x4 product, scale
+// is 12 multiplies and rotate 36 multiply-adds. The products are summed in
+// the same order as in glm's mat4 product.
+
+// m[0] * a + m[1] * b + m[2] * c
+static inline glm::vec4 combineColumns(const glm::mat4 &m, float a, float b, float c)
 {
-	stack.push(glm::mat4(1.0));
+#ifdef MATRIXSTACK_SSE
+	__m128 sum = _mm_mul_ps(_mm_loadu_ps(&m[0][0]), _mm_set1_ps(a));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[1][0]), _mm_set1_ps(b)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[2][0]), _mm_set1_ps(c)));
+	glm::vec4 result;
+	_mm_storeu_ps(&result[0], sum);
+	return result;
+#else
+	return m[0] * a + m[1] * b + m[2] * c;
+#endif
 }
 
-void MatrixStack::pushMatrix()
+MatrixStack::MatrixStack()
 {
-	const glm::mat4 &top = stack.top();
-	stack.push(top);
-	assert(stack.size() < MaxMatrixSize);
+	reset();
 }
 
-void MatrixStack::popMatrix()
+void MatrixStack::reset()
 {
-	assert(!stack.empty());
-	stack.pop();
-
-	// There should always be one matrix left.
-	assert(!stack.empty());
+	depth = 0;
+	stack[0] = glm::mat4(1.0);
 }
 
 void MatrixStack::loadIdentity()
 {
-	glm::mat4 &top = stack.top();
+	glm::mat4 &top = stack[depth];
 	top = glm::mat4(1.f);
 }
 
  void MatrixStack::perspective(float fovy, float aspect, float zNear, float zFar)
 {
-	glm::mat4 &top = stack.top();
+	glm::mat4 &top = stack[depth];
 	top *= glm::perspective(fovy, aspect, zNear, zFar);
 }
 
 void MatrixStack::translate(const glm::vec3 &offset)
 {
-	glm::mat4 &top = stack.top();
-	glm::mat4 t = glm::translate(glm::mat4(1.f), offset);
-	top *= t;
+	glm::mat4 &top = stack[depth];
+	top[3] = combineColumns(top, offset.x, offset.y, offset.z) + top[3];
 }
 
 void MatrixStack::scale(const glm::vec3 &scaleV)
 {
-	glm::mat4 &top = stack.top();
-	glm::mat4 s = glm::scale(glm::mat4(1.f), scaleV);
-	top *= s;
+	glm::mat4 &top = stack[depth];
+	top[0] *= scaleV.x;
+	top[1] *= scaleV.y;
+	top[2] *= scaleV.z;
 }
 
 void MatrixStack::scale(float size)
 {
-	glm::mat4 &top = stack.top();
-	glm::mat4 s = glm::scale(glm::mat4(1.f), glm::vec3(size));
-	top *= s;
+	glm::mat4 &top = stack[depth];
+	top[0] *= size;
+	top[1] *= size;
+	top[2] *= size;
 }
 
 void MatrixStack::rotate(float angle, const glm::vec3 &axis)
 {
-	glm::mat4 &top = stack.top();
-	glm::mat4 r = glm::rotate(glm::mat4(1.0), angle, axis);
-	top *= r;
+	glm::mat4 &top = stack[depth];
+
+	// The upper 3x3 of glm::rotate(), column by column
+	const float c = std::cos(angle);
+	const float s = std::sin(angle);
+	const glm::vec3 n = glm::normalize(axis);
+	const glm::vec3 t = (1.0f - c) * n;
+
+	const glm::vec4 c0 = combineColumns(top, c + t.x * n.x, t.x * n.y + s * n.z, t.x * n.z - s * n.y);
+	const glm::vec4 c1 = combineColumns(top, t.y * n.x - s * n.z, c + t.y * n.y, t.y * n.z + s * n.x);
+	const glm::vec4 c2 = combineColumns(top, t.z * n.x + s * n.y, t.z * n.y - s * n.x, c + t.z * n.z);
+	top[0] = c0;
+	top[1] = c1;
+	top[2] = c2;
 }
 
 void MatrixStack::multMatrix(const glm::mat4 &matrix)
 {
-	glm::mat4 &top = stack.top();
+	glm::mat4 &top = stack[depth];
 	top *= matrix;
 }
 
@@ -78,27 +106,22 @@ void MatrixStack::ortho(float left, float right, float bottom, float top, float
 	assert(bottom != top);
 	assert(zFar != zNear);
 
-	glm::mat4 &ctm = stack.top();
+	glm::mat4 &ctm = stack[depth];
 	ctm *= glm::ortho(left, right, bottom, top, zNear, zFar);
 }
 
 void MatrixStack::frustum(float left, float right, float bottom, float top, float zNear, float zFar)
 {
-	glm::mat4 &ctm = stack.top();
+	glm::mat4 &ctm = stack[depth];
 	ctm *= glm::frustum(left, right, bottom, top, zNear, zFar);
 }
 
 void MatrixStack::lookAt(const glm::vec3 &eye, const glm::vec3 &target, const glm::vec3 &up)
 {
-	glm::mat4 &top = stack.top();
+	glm::mat4 &top = stack[depth];
 	top *= glm::lookAt(eye, target, up);
 }
 
-const glm::mat4 &MatrixStack::topMatrix() const
-{
-	return stack.top();
-}
-
 void MatrixStack::print(const glm::mat4 &mat, const char *name)
 {
 	if (name)
@@ -124,5 +147,5 @@ void MatrixStack::print(const glm::mat4 &mat, const char *name)
 
 void MatrixStack::print(const char *name) const
 {
-	print(stack.top(), name);
+	print(stack[depth], name);
 }
@@ -3,7 +3,7 @@
 #ifndef LAB471_MATRIXSTACK_H_INCLUDED
 #define LAB471_MATRIXSTACK_H_INCLUDED
 
-#include <stack>
+#include <cassert>
 #include <memory>
 
 #include "glm/glm.hpp"
@@ -15,17 +15,41 @@
 class MatrixStack
 {
 
-	std::stack<glm::mat4> stack;
+public:
+
+	// Most matrices the stack can hold. They are stored inline, so pushing and
+	// popping never allocate.
+	static const int MaxDepth = 100;
+
+private:
+
+	glm::mat4 stack[MaxDepth];
+	// Index of the top matrix
+	int depth = 0;
 
 public:
 
 	MatrixStack();
 
+	// Back to a single identity matrix, so that one stack can be reused for
+	// every frame
+	void reset();
+
 	// Copies the current matrix and adds it to the top of the stack
-	void pushMatrix();
+	void pushMatrix()
+	{
+		assert(depth + 1 < MaxDepth);
+		stack[depth + 1] = stack[depth];
+		depth++;
+	}
 
 	// Removes the top of the stack and sets the current matrix to be the matrix that is now on top
-	void popMatrix();
+	void popMatrix()
+	{
+		// There should always be one matrix left.
+		assert(depth > 0);
+		depth--;
+	}
 
 	//  Sets the top matrix to be the identity
 	void loadIdentity();
@@ -34,6 +58,9 @@ public:
 	void multMatrix(const glm::mat4 &matrix);
 
 
+	// translate(), scale() and rotate() apply the transform to the top matrix
+	// in place, without building the transform matrix and multiplying by it
+
 	// Right multiplies the top matrix by a translation matrix
 	void translate(const glm::vec3 &offset);
 
@@ -48,7 +75,7 @@ public:
 
 
 	// Gets the top matrix
-	const glm::mat4 &topMatrix() const;
+	const glm::mat4 &topMatrix() const { return stack[depth]; }
 
 	// Sets the top matrix to be an orthogonal projection matrix
 	void ortho(float left, float right, float bottom, float top, float zNear, float zFar);
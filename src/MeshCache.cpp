@@ -0,0 +1,126 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+
+namespace MeshCache
+{
+
+// Bump whenever the layout or the meaning of the stored data changes.
+static const uint32_t FormatVersion = 1;
+
+struct Header
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceMTime;
+	uint32_t posCount;
+	uint32_t norCount;
+	uint32_t texCount;
+	uint32_t eleCount;
+};
+
+static bool sourceStamp(const string &meshName, uint64_t &size, int64_t &mtime)
+{
+	struct stat sb;
+	if (stat(meshName.c_str(), &sb) != 0)
+	{
+		return false;
+	}
+	size = (uint64_t) sb.st_size;
+	mtime = (int64_t) sb.st_mtime;
+	return true;
+}
+
+string cacheName(const string &meshName)
+{
+	return meshName + ".meshcache";
+}
+
+bool read(const string &meshName,
+	vector<float> &posBuf, vector<float> &norBuf,
+	vector<float> &texBuf, vector<unsigned int> &eleBuf)
+{
+	uint64_t size;
+	int64_t mtime;
+	if (!sourceStamp(meshName, size, mtime))
+	{
+		return false;
+	}
+
+	MappedFile file;
+	if (!file.open(cacheName(meshName)) || file.size() < sizeof(Header))
+	{
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, file.data(), sizeof(Header));
+	if (memcmp(header.magic, "MSHC", 4) != 0 || header.version != FormatVersion ||
+		header.sourceSize != size || header.sourceMTime != mtime)
+	{
+		return false;
+	}
+
+	const size_t expected = sizeof(Header) +
+		sizeof(float) * ((size_t) header.posCount + header.norCount + header.texCount) +
+		sizeof(unsigned int) * header.eleCount;
+	if (file.size() != expected)
+	{
+		return false;
+	}
+
+	const float *floats = (const float *) (file.data() + sizeof(Header));
+	posBuf.assign(floats, floats + header.posCount);
+	floats += header.posCount;
+	norBuf.assign(floats, floats + header.norCount);
+	floats += header.norCount;
+	texBuf.assign(floats, floats + header.texCount);
+	floats += header.texCount;
+	const unsigned int *indices = (const unsigned int *) floats;
+	eleBuf.assign(indices, indices + header.eleCount);
+
+	return true;
+}
+
+bool write(const string &meshName,
+	const vector<float> &posBuf, const vector<float> &norBuf,
+	const vector<float> &texBuf, const vector<unsigned int> &eleBuf)
+{
+	Header header;
+	memcpy(header.magic, "MSHC", 4);
+	header.version = FormatVersion;
+	if (!sourceStamp(meshName, header.sourceSize, header.sourceMTime))
+	{
+		return false;
+	}
+	header.posCount = (uint32_t) posBuf.size();
+	header.norCount = (uint32_t) norBuf.size();
+	header.texCount = (uint32_t) texBuf.size();
+	header.eleCount = (uint32_t) eleBuf.size();
+
+	ofstream out(cacheName(meshName).c_str(), ios::binary | ios::trunc);
+	if (!out)
+	{
+		cerr << "Could not write mesh cache: '" << cacheName(meshName) << "'" << endl;
+		return false;
+	}
+
+	out.write((const char *) &header, sizeof(Header));
+	out.write((const char *) posBuf.data(), posBuf.size() * sizeof(float));
+	out.write((const char *) norBuf.data(), norBuf.size() * sizeof(float));
+	out.write((const char *) texBuf.data(), texBuf.size() * sizeof(float));
+	out.write((const char *) eleBuf.data(), eleBuf.size() * sizeof(unsigned int));
+
+	return (bool) out;
+}
+
+}
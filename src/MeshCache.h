@@ -0,0 +1,33 @@
+#pragma once
+#ifndef LAB471_MESHCACHE_H_INCLUDED
+#define LAB471_MESHCACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+
+// Binary cache for meshes that have already been loaded and resized.
+//
+// The cache lives next to the .obj file (<mesh>.obj.meshcache) and holds a
+// small header followed by the position, normal, texture coordinate and
+// index arrays exactly as Shape uploads them. It is memory-mapped on load.
+// The header records the size and modification time of the .obj, so editing
+// the .obj invalidates the cache and it is rebuilt on the next load.
+namespace MeshCache
+{
+	// Path of the cache file that belongs to an .obj file
+	std::string cacheName(const std::string &meshName);
+
+	// Fills the buffers from the cache. Returns false if there is no cache or
+	// it is out of date, in which case the buffers are left untouched.
+	bool read(const std::string &meshName,
+		std::vector<float> &posBuf, std::vector<float> &norBuf,
+		std::vector<float> &texBuf, std::vector<unsigned int> &eleBuf);
+
+	// Writes the buffers to the cache. Returns false if it cannot be written.
+	bool write(const std::string &meshName,
+		const std::vector<float> &posBuf, const std::vector<float> &norBuf,
+		const std::vector<float> &texBuf, const std::vector<unsigned int> &eleBuf);
+}
+
+#endif // LAB471_MESHCACHE_H_INCLUDED
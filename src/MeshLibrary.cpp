@@ -0,0 +1,127 @@
+#include "MeshLibrary.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <climits>
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+
+// Resolves "./res/../res/cube.obj" and "res/cube.obj" to the same key
+static string canonicalPath(const string &fileName)
+{
+#ifdef _WIN32
+	char buf[_MAX_PATH];
+	if (_fullpath(buf, fileName.c_str(), _MAX_PATH))
+	{
+		return buf;
+	}
+#else
+	char buf[PATH_MAX];
+	if (realpath(fileName.c_str(), buf))
+	{
+		return buf;
+	}
+#endif
+	return fileName;
+}
+
+shared_ptr<Shape> MeshLibrary::get(const string &meshName)
+{
+	const string key = canonicalPath(meshName);
+
+	Entry &entry = meshes[key];
+	shared_ptr<Shape> shape = entry.shape.lock();
+	if (shape)
+	{
+		hits++;
+		savedCPUBytes += entry.cpuBytes;
+		savedGPUBytes += entry.gpuBytes;
+		return shape;
+	}
+
+	shape = make_shared<Shape>();
+	shape->loadMeshCached(meshName);
+	if (optimizeMeshes)
+	{
+		shape->optimize(optimizeOverdraw);
+	}
+	shape->setGPUResidentOnly(releaseCPU);
+	shape->setVertexFormat(vertexFormat);
+	shape->setMeshletSplit(meshletSplit);
+
+	entry.cpuBytes = shape->getCPUBytes();
+	shape->init();
+	loads++;
+
+	entry.shape = shape;
+	entry.gpuBytes = shape->getGPUBytes();
+	savedCPUBytes += entry.cpuBytes - shape->getCPUBytes();
+
+	return shape;
+}
+
+vector<string> MeshLibrary::listMeshes(const string &dir)
+{
+	vector<string> files;
+	auto isObj = [](const string &name)
+	{
+		return name.size() > 4 && name.compare(name.size() - 4, 4, ".obj") == 0;
+	};
+
+#ifdef _WIN32
+	_finddata_t data;
+	intptr_t handle = _findfirst((dir + "/*.obj").c_str(), &data);
+	if (handle != -1)
+	{
+		do
+		{
+			if (isObj(data.name))
+			{
+				files.push_back(dir + "/" + data.name);
+			}
+		} while (_findnext(handle, &data) == 0);
+		_findclose(handle);
+	}
+#else
+	DIR *d = opendir(dir.c_str());
+	if (d)
+	{
+		while (dirent *entry = readdir(d))
+		{
+			if (isObj(entry->d_name))
+			{
+				files.push_back(dir + "/" + entry->d_name);
+			}
+		}
+		closedir(d);
+	}
+#endif
+
+	sort(files.begin(), files.end());
+	return files;
+}
+
+void MeshLibrary::printStats() const
+{
+	cout << "MeshLibrary: " << loads << " meshes loaded, " << hits << " shared" << endl;
+	cout << "MeshLibrary: saved " << savedCPUBytes << " bytes of system memory, "
+		<< savedGPUBytes << " bytes of GPU memory" << endl;
+
+	for (const auto &it : meshes)
+	{
+		shared_ptr<Shape> shape = it.second.shape.lock();
+		if (shape)
+		{
+			shape->printMemoryStats(it.first);
+			shape->printCacheStats(it.first);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef LAB471_MESHLIBRARY_H_INCLUDED
+#define LAB471_MESHLIBRARY_H_INCLUDED
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shape.h"
+
+
+// Hands out shared meshes so that every .obj file is loaded and uploaded to
+// the GPU only once. Meshes are keyed by their canonical path and reference
+// counted; a mesh is freed once the last shared_ptr to it goes away, and is
+// reloaded if it is requested again after that.
+class MeshLibrary
+{
+
+public:
+
+	// Returns the loaded, resized and uploaded mesh for meshName
+	std::shared_ptr<Shape> get(const std::string &meshName);
+
+	// Load new meshes GPU-resident only, i.e. drop the CPU copies of the mesh
+	// data right after upload (default off)
+	void setReleaseCPUBuffers(bool release) { releaseCPU = release; }
+
+	// GPU vertex layout used for meshes loaded from now on
+	void setVertexFormat(Shape::VertexFormat format) { vertexFormat = format; }
+
+	// Split meshes too large for 16 bit indices into meshlets (default off)
+	void setMeshletSplit(bool split) { meshletSplit = split; }
+
+	// Run the vertex cache optimizer on meshes loaded from now on, optionally
+	// with the overdraw pass (default off)
+	void setOptimize(bool optimize, bool overdraw = false)
+	{
+		optimizeMeshes = optimize;
+		optimizeOverdraw = overdraw;
+	}
+
+	// Paths of all .obj files in dir, sorted
+	static std::vector<std::string> listMeshes(const std::string &dir);
+
+	// Memory not spent thanks to sharing and releasing CPU copies
+	size_t getSavedCPUBytes() const { return savedCPUBytes; }
+	size_t getSavedGPUBytes() const { return savedGPUBytes; }
+
+	// Also prints the per mesh CPU/GPU breakdown and vertex cache stats of
+	// every live mesh
+	void printStats() const;
+
+private:
+
+	struct Entry
+	{
+		std::weak_ptr<Shape> shape;
+		// Sizes right after loading, i.e. what another copy would cost
+		size_t cpuBytes = 0;
+		size_t gpuBytes = 0;
+	};
+
+	std::map<std::string, Entry> meshes;
+	bool releaseCPU = false;
+	Shape::VertexFormat vertexFormat = Shape::VertexFormat::Separate;
+	bool meshletSplit = false;
+	bool optimizeMeshes = false;
+	bool optimizeOverdraw = false;
+
+	int loads = 0;
+	int hits = 0;
+	size_t savedCPUBytes = 0;
+	size_t savedGPUBytes = 0;
+
+};
+
+#endif // LAB471_MESHLIBRARY_H_INCLUDED
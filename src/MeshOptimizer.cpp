@@ -0,0 +1,319 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+namespace MeshOptimizer
+{
+
+CacheStats analyzeVertexCache(const vector<unsigned int> &indices,
+	size_t vertCount, unsigned int cacheSize)
+{
+	CacheStats stats;
+	const size_t triCount = indices.size() / 3;
+	if (triCount == 0 || vertCount == 0)
+	{
+		return stats;
+	}
+
+	// A vertex is in the FIFO if it was pushed less than cacheSize misses ago;
+	// hits do not move it
+	vector<size_t> pushedAt(vertCount, 0);
+	size_t clock = cacheSize + 1;
+	size_t misses = 0;
+
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		const unsigned int v = indices[i];
+		if (clock - pushedAt[v] > cacheSize)
+		{
+			pushedAt[v] = clock++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (float) misses / (float) triCount;
+	stats.atvr = (float) misses / (float) vertCount;
+	return stats;
+}
+
+void reorderTriangles(vector<unsigned int> &indices, size_t vertCount,
+	vector<size_t> *clusters, unsigned int cacheSize)
+{
+	const size_t triCount = indices.size() / 3;
+	if (clusters)
+	{
+		clusters->clear();
+	}
+	if (triCount == 0 || vertCount == 0)
+	{
+		return;
+	}
+
+	// Triangles around every vertex, as offsets into one flat array
+	vector<unsigned int> liveCount(vertCount, 0);
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		liveCount[indices[i]]++;
+	}
+	vector<size_t> adjStart(vertCount + 1, 0);
+	for (size_t v = 0; v < vertCount; v++)
+	{
+		adjStart[v + 1] = adjStart[v] + liveCount[v];
+	}
+	vector<unsigned int> adjacency(adjStart[vertCount]);
+	vector<size_t> fill(adjStart.begin(), adjStart.end() - 1);
+	for (size_t t = 0; t < triCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			adjacency[fill[indices[3*t + c]]++] = (unsigned int) t;
+		}
+	}
+
+	vector<unsigned int> result;
+	result.reserve(triCount * 3);
+	vector<bool> emitted(triCount, false);
+	vector<size_t> cacheTime(vertCount, 0);
+	vector<unsigned int> deadEnd;
+	vector<unsigned int> candidates;
+	size_t clock = cacheSize + 1;
+	size_t cursor = 1;
+	long fan = 0;
+	bool newCluster = true;
+
+	while (fan >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (size_t a = adjStart[fan]; a < adjStart[fan + 1]; a++)
+		{
+			const unsigned int t = adjacency[a];
+			if (emitted[t])
+			{
+				continue;
+			}
+			if (newCluster && clusters)
+			{
+				clusters->push_back(result.size());
+			}
+			newCluster = false;
+
+			for (int c = 0; c < 3; c++)
+			{
+				const unsigned int v = indices[3*t + c];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+				if (clock - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = clock++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// Prefer the candidate that has been in the cache longest and will
+		// still be there after its remaining triangles are emitted
+		long next = -1;
+		long bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (liveCount[v] == 0)
+			{
+				continue;
+			}
+			long priority = 0;
+			if (clock - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+			{
+				priority = (long) (clock - cacheTime[v]);
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next == -1)
+		{
+			// Dead end: go back to a recently used vertex, or scan ahead
+			newCluster = true;
+			while (! deadEnd.empty() && next == -1)
+			{
+				const unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveCount[v] > 0)
+				{
+					next = v;
+				}
+			}
+			while (cursor < vertCount && next == -1)
+			{
+				if (liveCount[cursor] > 0)
+				{
+					next = (long) cursor;
+				}
+				cursor++;
+			}
+		}
+		fan = next;
+	}
+
+	// Keep a trailing partial triangle, if the list had one
+	result.insert(result.end(), indices.begin() + triCount * 3, indices.end());
+	indices.swap(result);
+}
+
+void reorderForOverdraw(vector<unsigned int> &indices, const vector<float> &posBuf,
+	const vector<size_t> &clusters, float threshold)
+{
+	const size_t vertCount = posBuf.size() / 3;
+	const size_t end = indices.size() / 3 * 3;
+	if (clusters.size() < 2 || vertCount == 0)
+	{
+		return;
+	}
+
+	struct Cluster
+	{
+		size_t start, end;
+		float centroid[3];
+		float normal[3];
+		float area;
+		float sortKey;
+	};
+
+	// Area weighted centroid and normal of every cluster
+	vector<Cluster> info(clusters.size());
+	float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		Cluster &cl = info[c];
+		cl.start = clusters[c];
+		cl.end = c + 1 < clusters.size() ? clusters[c + 1] : end;
+		cl.centroid[0] = cl.centroid[1] = cl.centroid[2] = 0.0f;
+		cl.normal[0] = cl.normal[1] = cl.normal[2] = 0.0f;
+		cl.area = 0.0f;
+
+		for (size_t i = cl.start; i < cl.end; i += 3)
+		{
+			const float *p0 = &posBuf[3 * indices[i + 0]];
+			const float *p1 = &posBuf[3 * indices[i + 1]];
+			const float *p2 = &posBuf[3 * indices[i + 2]];
+			const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+			const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+			const float n[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2],
+				e1[0]*e2[1] - e1[1]*e2[0]};
+			const float area = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+			for (int k = 0; k < 3; k++)
+			{
+				cl.centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+				cl.normal[k] += n[k];
+			}
+			cl.area += area;
+		}
+
+		if (cl.area > 0.0f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				meshCentroid[k] += cl.centroid[k];
+				cl.centroid[k] /= cl.area;
+			}
+		}
+		meshArea += cl.area;
+	}
+	if (meshArea > 0.0f)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			meshCentroid[k] /= meshArea;
+		}
+	}
+
+	// Clusters facing away from the center are on the outside and go first
+	for (Cluster &cl : info)
+	{
+		const float len = sqrtf(cl.normal[0]*cl.normal[0] + cl.normal[1]*cl.normal[1] +
+			cl.normal[2]*cl.normal[2]);
+		cl.sortKey = 0.0f;
+		if (len > 0.0f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				cl.sortKey += (cl.centroid[k] - meshCentroid[k]) * cl.normal[k] / len;
+			}
+		}
+	}
+	stable_sort(info.begin(), info.end(),
+		[](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+	vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (const Cluster &cl : info)
+	{
+		sorted.insert(sorted.end(), indices.begin() + cl.start, indices.begin() + cl.end);
+	}
+	sorted.insert(sorted.end(), indices.begin() + end, indices.end());
+
+	const float before = analyzeVertexCache(indices, vertCount).acmr;
+	const float after = analyzeVertexCache(sorted, vertCount).acmr;
+	if (after <= before * threshold)
+	{
+		indices.swap(sorted);
+	}
+}
+
+// Moves the entries of an attribute array with the given components per
+// vertex to their new slots
+static void remapAttribute(vector<float> &buf, int components,
+	const vector<unsigned int> &remap, size_t oldCount, size_t newCount)
+{
+	if (buf.size() != oldCount * components)
+	{
+		return;
+	}
+
+	vector<float> moved(newCount * components);
+	for (size_t v = 0; v < oldCount; v++)
+	{
+		if (remap[v] != ~0u)
+		{
+			for (int k = 0; k < components; k++)
+			{
+				moved[remap[v] * components + k] = buf[v * components + k];
+			}
+		}
+	}
+	buf.swap(moved);
+}
+
+void reorderVertices(vector<unsigned int> &indices, vector<float> &posBuf,
+	vector<float> &norBuf, vector<float> &texBuf)
+{
+	const size_t vertCount = posBuf.size() / 3;
+
+	vector<unsigned int> remap(vertCount, ~0u);
+	unsigned int next = 0;
+	for (unsigned int &index : indices)
+	{
+		if (remap[index] == ~0u)
+		{
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+
+	remapAttribute(posBuf, 3, remap, vertCount, next);
+	remapAttribute(norBuf, 3, remap, vertCount, next);
+	remapAttribute(texBuf, 2, remap, vertCount, next);
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef LAB471_MESHOPTIMIZER_H_INCLUDED
+#define LAB471_MESHOPTIMIZER_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+
+// Reorders indexed triangle lists for the GPU's post-transform vertex cache.
+//
+// The order that comes out of the .obj loader is whatever order the file
+// lists its faces in. The passes below reorder the triangles with Tipsify
+// (Sander, Nehab and Barczak 2007), optionally sort the resulting clusters
+// front to back for less overdraw, and finally renumber the vertices in the
+// order they are first used so that vertex fetch walks memory linearly.
+namespace MeshOptimizer
+{
+	// Size of the FIFO vertex cache that is optimized for and simulated
+	const unsigned int CacheSize = 16;
+
+	// ACMR: vertices transformed per triangle (0.5 is optimal, 3 is worst).
+	// ATVR: vertices transformed per vertex (1 is optimal).
+	struct CacheStats
+	{
+		float acmr = 0.0f;
+		float atvr = 0.0f;
+	};
+
+	// Simulates a FIFO cache of cacheSize entries over the index list
+	CacheStats analyzeVertexCache(const std::vector<unsigned int> &indices,
+		size_t vertCount, unsigned int cacheSize = CacheSize);
+
+	// Tipsify triangle reordering. If clusters is given, it receives the first
+	// index of every run that starts at a dead end; those runs can be moved
+	// around as a whole without hurting the cache much.
+	void reorderTriangles(std::vector<unsigned int> &indices, size_t vertCount,
+		std::vector<size_t> *clusters = nullptr, unsigned int cacheSize = CacheSize);
+
+	// Sorts the clusters from reorderTriangles() so that the ones facing away
+	// from the mesh center, which tend to occlude the rest, are drawn first.
+	// The new order is only kept if the ACMR grows by at most the threshold
+	// factor.
+	void reorderForOverdraw(std::vector<unsigned int> &indices, const std::vector<float> &posBuf,
+		const std::vector<size_t> &clusters, float threshold = 1.05f);
+
+	// Renumbers the vertices in the order the indices first use them and
+	// reorders the attribute arrays to match; unreferenced vertices are
+	// dropped. Arrays that do not have one entry per vertex are left alone.
+	void reorderVertices(std::vector<unsigned int> &indices, std::vector<float> &posBuf,
+		std::vector<float> &norBuf, std::vector<float> &texBuf);
+}
+
+#endif // LAB471_MESHOPTIMIZER_H_INCLUDED
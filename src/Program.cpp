@@ -2,9 +2,12 @@
 #include "Program.h"
 #include <iostream>
 #include <cassert>
+#include <chrono>
 #include <fstream>
 
 #include "GLSL.h"
+#include "GLState.h"
+#include "ProgramCache.h"
 
 
 std::string readFileAsString(const std::string &fileName)
@@ -35,89 +38,358 @@ void Program::setShaderNames(const std::string &v, const std::string &f)
 }
 
 bool Program::init()
+{
+	submit();
+	return finish();
+}
+
+// Lets the driver compile on as many threads as it likes. Without
+// KHR_parallel_shader_compile many drivers still compile in the background,
+// as long as nobody asks for the status right away.
+static void enableParallelCompile()
+{
+	static bool enabled = false;
+	if (!enabled && GLAD_GL_KHR_parallel_shader_compile)
+	{
+		CHECKED_GL_CALL(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+	}
+	enabled = true;
+}
+
+static GLuint submitShader(GLenum type, const std::string &source)
+{
+	GLuint shader = glCreateShader(type);
+	const char *text = source.c_str();
+	CHECKED_GL_CALL(glShaderSource(shader, 1, &text, NULL));
+	CHECKED_GL_CALL(glCompileShader(shader));
+	return shader;
+}
+
+bool Program::checkCompile(GLuint shader, const std::string &name, const char *stage) const
 {
 	GLint rc;
+	CHECKED_GL_CALL(glGetShaderiv(shader, GL_COMPILE_STATUS, &rc));
+	if (!rc && isVerbose())
+	{
+		GLSL::printShaderInfoLog(shader);
+		std::cout << "Error compiling " << stage << " shader " << name << std::endl;
+	}
+	return rc != 0;
+}
 
-	// Create shader handles
-	GLuint VS = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FS = glCreateShader(GL_FRAGMENT_SHADER);
+void Program::startBuild(Build &build) const
+{
+	enableParallelCompile();
 
 	// Read shader sources
 	std::string vShaderString = readFileAsString(vShaderName);
 	std::string fShaderString = readFileAsString(fShaderName);
-	const char *vshader = vShaderString.c_str();
-	const char *fshader = fShaderString.c_str();
-	CHECKED_GL_CALL(glShaderSource(VS, 1, &vshader, NULL));
-	CHECKED_GL_CALL(glShaderSource(FS, 1, &fshader, NULL));
-
-	// Compile vertex shader
-	CHECKED_GL_CALL(glCompileShader(VS));
-	CHECKED_GL_CALL(glGetShaderiv(VS, GL_COMPILE_STATUS, &rc));
-	if (!rc)
+
+	build.retrievable = ProgramCache::isAvailable();
+	build.sourceHash = ProgramCache::sourceHash(vShaderString, fShaderString);
+	build.fromCache = build.retrievable && loadBinary(build);
+	if (build.fromCache)
 	{
-		if (isVerbose())
+		return;
+	}
+
+	build.vShader = submitShader(GL_VERTEX_SHADER, vShaderString);
+	build.fShader = submitShader(GL_FRAGMENT_SHADER, fShaderString);
+
+	// Create the program and link
+	build.pid = glCreateProgram();
+	CHECKED_GL_CALL(glAttachShader(build.pid, build.vShader));
+	CHECKED_GL_CALL(glAttachShader(build.pid, build.fShader));
+	// Shaders without layout qualifiers still get the locations Shape bakes
+	// into its VAOs
+	CHECKED_GL_CALL(glBindAttribLocation(build.pid, GLSL::VertPosLocation, "vertPos"));
+	CHECKED_GL_CALL(glBindAttribLocation(build.pid, GLSL::VertNorLocation, "vertNor"));
+	CHECKED_GL_CALL(glBindAttribLocation(build.pid, GLSL::VertTexLocation, "vertTex"));
+	CHECKED_GL_CALL(glBindAttribLocation(build.pid, GLSL::InstModelLocation, "instModel"));
+	CHECKED_GL_CALL(glBindAttribLocation(build.pid, GLSL::InstMaterialLocation, "instMaterial"));
+	if (build.retrievable)
+	{
+		CHECKED_GL_CALL(glProgramParameteri(build.pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	}
+	CHECKED_GL_CALL(glLinkProgram(build.pid));
+}
+
+bool Program::isBuildDone(const Build &build) const
+{
+	GLint done = 1;
+	if (!build.fromCache && GLAD_GL_KHR_parallel_shader_compile)
+	{
+		CHECKED_GL_CALL(glGetProgramiv(build.pid, GL_COMPLETION_STATUS_KHR, &done));
+	}
+	return done != 0;
+}
+
+bool Program::completeBuild(Build &build) const
+{
+	if (build.fromCache)
+	{
+		return true;
+	}
+
+	const bool vCompiled = checkCompile(build.vShader, vShaderName, "vertex");
+	const bool fCompiled = checkCompile(build.fShader, fShaderName, "fragment");
+	GLint rc;
+	CHECKED_GL_CALL(glGetProgramiv(build.pid, GL_LINK_STATUS, &rc));
+	if (vCompiled && fCompiled && !rc && isVerbose())
+	{
+		GLSL::printProgramInfoLog(build.pid);
+		std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+	}
+
+	// The linked program does not need the shader objects any more
+	CHECKED_GL_CALL(glDetachShader(build.pid, build.vShader));
+	CHECKED_GL_CALL(glDetachShader(build.pid, build.fShader));
+	CHECKED_GL_CALL(glDeleteShader(build.vShader));
+	CHECKED_GL_CALL(glDeleteShader(build.fShader));
+	build.vShader = build.fShader = 0;
+
+	if (!vCompiled || !fCompiled || !rc)
+	{
+		CHECKED_GL_CALL(glDeleteProgram(build.pid));
+		build.pid = 0;
+		return false;
+	}
+	if (build.retrievable)
+	{
+		saveBinary(build);
+	}
+	return true;
+}
+
+void Program::adopt(const Build &build)
+{
+	pid = build.pid;
+	fromCache = build.fromCache;
+
+	// Attach the shared uniform blocks, if the shaders use them
+	bindUniformBlock("Frame", GLSL::FrameBlockBinding);
+	bindUniformBlock("Materials", GLSL::MaterialBlockBinding);
+
+	// Look up everything that was added so far; the ids stay the same
+	state = State::Linked;
+	for (const auto &attribute : attributes)
+	{
+		attributeLocations[attribute.second] = lookupAttribute(attribute.first);
+	}
+	for (const auto &uniform : uniforms)
+	{
+		uniformLocations[uniform.second] = lookupUniform(uniform.first);
+	}
+}
+
+void Program::submit()
+{
+	auto start = std::chrono::steady_clock::now();
+	building = Build();
+	startBuild(building);
+	state = State::Submitted;
+	initSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Program::finish()
+{
+	if (state != State::Submitted)
+	{
+		return state == State::Linked;
+	}
+	auto start = std::chrono::steady_clock::now();
+
+	// Whether the driver was done before anybody had to wait for it
+	const bool background = !building.fromCache && GLAD_GL_KHR_parallel_shader_compile && isBuildDone(building);
+	if (!completeBuild(building))
+	{
+		state = State::Failed;
+		return false;
+	}
+	adopt(building);
+	building = Build();
+
+	initSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (isVerbose())
+	{
+		std::cout << vShaderName << " + " << fShaderName << ": " << (fromCache ? "cache hit" : "compiled")
+			<< (background ? " in the background" : "") << ", " << initSeconds * 1000.0 << " ms" << std::endl;
+	}
+
+	return true;
+}
+
+bool Program::usesShader(const std::string &fileName) const
+{
+	return fileName == vShaderName || fileName == fShaderName;
+}
+
+void Program::reload()
+{
+	if (state != State::Linked)
+	{
+		return;
+	}
+	if (reloading)
+	{
+		// Changed again before the last change linked, start over
+		if (!building.fromCache)
 		{
-			GLSL::printShaderInfoLog(VS);
-			std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
+			CHECKED_GL_CALL(glDeleteShader(building.vShader));
+			CHECKED_GL_CALL(glDeleteShader(building.fShader));
 		}
+		CHECKED_GL_CALL(glDeleteProgram(building.pid));
+	}
+	building = Build();
+	startBuild(building);
+	reloading = true;
+}
+
+bool Program::updateReload()
+{
+	if (!reloading || !isBuildDone(building))
+	{
 		return false;
 	}
+	reloading = false;
 
-	// Compile fragment shader
-	CHECKED_GL_CALL(glCompileShader(FS));
-	CHECKED_GL_CALL(glGetShaderiv(FS, GL_COMPILE_STATUS, &rc));
-	if (!rc)
+	if (!completeBuild(building))
 	{
 		if (isVerbose())
 		{
-			GLSL::printShaderInfoLog(FS);
-			std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+			std::cout << "Keeping the previous " << vShaderName << " + " << fShaderName << std::endl;
 		}
+		building = Build();
 		return false;
 	}
 
-	// Create the program and link
-	pid = glCreateProgram();
-	CHECKED_GL_CALL(glAttachShader(pid, VS));
-	CHECKED_GL_CALL(glAttachShader(pid, FS));
-	CHECKED_GL_CALL(glLinkProgram(pid));
-	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
+	GLState::deleteProgram(pid);
+	adopt(building);
+	building = Build();
+	if (isVerbose())
+	{
+		std::cout << "Reloaded " << vShaderName << " + " << fShaderName << std::endl;
+	}
+	return true;
+}
+
+bool Program::loadBinary(Build &build) const
+{
+	GLenum format;
+	std::vector<char> binary;
+	if (!ProgramCache::read(vShaderName, fShaderName, build.sourceHash, format, binary))
+	{
+		return false;
+	}
+
+	GLint rc;
+	build.pid = glCreateProgram();
+	CHECKED_GL_CALL(glProgramBinary(build.pid, format, binary.data(), (GLsizei) binary.size()));
+	CHECKED_GL_CALL(glGetProgramiv(build.pid, GL_LINK_STATUS, &rc));
 	if (!rc)
 	{
+		// Not an error, e.g. the driver changed the format without a version bump
 		if (isVerbose())
 		{
-			GLSL::printProgramInfoLog(pid);
-			std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+			std::cout << "Cached binary of " << vShaderName << " and " << fShaderName
+				<< " was rejected, compiling" << std::endl;
 		}
+		CHECKED_GL_CALL(glDeleteProgram(build.pid));
+		build.pid = 0;
 		return false;
 	}
-
 	return true;
 }
 
+void Program::saveBinary(const Build &build) const
+{
+	GLint length = 0;
+	CHECKED_GL_CALL(glGetProgramiv(build.pid, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+	{
+		return;
+	}
+
+	GLenum format;
+	std::vector<char> binary(length);
+	CHECKED_GL_CALL(glGetProgramBinary(build.pid, length, &length, &format, binary.data()));
+	binary.resize(length);
+	ProgramCache::write(vShaderName, fShaderName, build.sourceHash, format, binary);
+}
+
+void Program::bindUniformBlock(const std::string &name, GLuint binding)
+{
+	GLuint index = glGetUniformBlockIndex(pid, name.c_str());
+	if (index != GL_INVALID_INDEX)
+	{
+		CHECKED_GL_CALL(glUniformBlockBinding(pid, index, binding));
+	}
+}
+
 void Program::bind()
 {
-	CHECKED_GL_CALL(glUseProgram(pid));
+	if (state == State::Submitted)
+	{
+		finish();
+	}
+	CHECKED_GL_CALL(GLState::useProgram(pid));
 }
 
 void Program::unbind()
 {
-	CHECKED_GL_CALL(glUseProgram(0));
+	CHECKED_GL_CALL(GLState::useProgram(0));
 }
 
-void Program::addAttribute(const std::string &name)
+// Until finish() the program may still be linking; it looks the names up then
+GLint Program::lookupAttribute(const std::string &name) const
 {
-	attributes[name] = GLSL::getAttribLocation(pid, name.c_str(), isVerbose());
+	return state == State::Linked ? GLSL::getAttribLocation(pid, name.c_str(), isVerbose()) : -1;
 }
 
-void Program::addUniform(const std::string &name)
+GLint Program::lookupUniform(const std::string &name) const
 {
-	uniforms[name] = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
+	return state == State::Linked ? GLSL::getUniformLocation(pid, name.c_str(), isVerbose()) : -1;
+}
+
+Program::AttributeID Program::addAttribute(const std::string &name)
+{
+	AttributeID id;
+	std::map<std::string, int>::const_iterator attribute = attributes.find(name);
+	if (attribute != attributes.end())
+	{
+		id.index = attribute->second;
+		attributeLocations[id.index] = lookupAttribute(name);
+	}
+	else
+	{
+		id.index = (int) attributeLocations.size();
+		attributes[name] = id.index;
+		attributeLocations.push_back(lookupAttribute(name));
+	}
+	return id;
+}
+
+Program::UniformID Program::addUniform(const std::string &name)
+{
+	UniformID id;
+	std::map<std::string, int>::const_iterator uniform = uniforms.find(name);
+	if (uniform != uniforms.end())
+	{
+		id.index = uniform->second;
+		uniformLocations[id.index] = lookupUniform(name);
+	}
+	else
+	{
+		id.index = (int) uniformLocations.size();
+		uniforms[name] = id.index;
+		uniformLocations.push_back(lookupUniform(name));
+	}
+	return id;
 }
 
 GLint Program::getAttribute(const std::string &name) const
 {
-	std::map<std::string, GLint>::const_iterator attribute = attributes.find(name.c_str());
+	std::map<std::string, int>::const_iterator attribute = attributes.find(name.c_str());
 	if (attribute == attributes.end())
 	{
 		if (isVerbose())
@@ -126,12 +398,12 @@ GLint Program::getAttribute(const std::string &name) const
 		}
 		return -1;
 	}
-	return attribute->second;
+	return attributeLocations[attribute->second];
 }
 
 GLint Program::getUniform(const std::string &name) const
 {
-	std::map<std::string, GLint>::const_iterator uniform = uniforms.find(name.c_str());
+	std::map<std::string, int>::const_iterator uniform = uniforms.find(name.c_str());
 	if (uniform == uniforms.end())
 	{
 		if (isVerbose())
@@ -140,5 +412,5 @@ GLint Program::getUniform(const std::string &name) const
 		}
 		return -1;
 	}
-	return uniform->second;
+	return uniformLocations[uniform->second];
 }
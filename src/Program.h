@@ -4,8 +4,10 @@
 #ifndef LAB471_PROGRAM_H_INCLUDED
 #define LAB471_PROGRAM_H_INCLUDED
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 
@@ -21,15 +23,60 @@ public:
 	bool isVerbose() const { return verbose; }
 
 	void setShaderNames(const std::string &v, const std::string &f);
+	const std::string &getVertexShaderName() const { return vShaderName; }
+	const std::string &getFragmentShaderName() const { return fShaderName; }
+	// submit() followed by finish()
 	virtual bool init();
+
+	// Two-phase init, so that the driver can compile and link while the
+	// application loads meshes and textures (on several threads with
+	// KHR_parallel_shader_compile).
+	//
+	// submit() loads the program from its binary in the ProgramCache if it is
+	// there and the driver accepts it, else starts compiling and linking the
+	// shaders without waiting for the result. finish() waits for the link,
+	// reports errors, stores the binary for next time and looks up the
+	// attributes and uniforms added in the meantime; it returns false if the
+	// program did not link. bind() calls finish() if nobody did.
+	void submit();
+	bool finish();
+
+	// Hot reload: reload() starts compiling the shaders again in the
+	// background, e.g. after usesShader() said that a changed file is one of
+	// them. updateReload(), called once per frame, swaps the new program in
+	// once the driver is done linking it and looks the attributes and
+	// uniforms up again; their ids stay valid. A program that does not link
+	// is thrown away and the old one is kept. Returns true on a swap.
+	bool usesShader(const std::string &fileName) const;
+	void reload();
+	bool updateReload();
 	virtual void bind();
 	virtual void unbind();
 
-	void addAttribute(const std::string &name);
-	void addUniform(const std::string &name);
+	// Compact ids handed out by addAttribute()/addUniform(). Looking one up
+	// is an array access, use them on the hot path.
+	struct AttributeID { int index = -1; };
+	struct UniformID { int index = -1; };
+
+	AttributeID addAttribute(const std::string &name);
+	UniformID addUniform(const std::string &name);
+	GLint getAttribute(AttributeID id) const { return id.index >= 0 ? attributeLocations[id.index] : -1; }
+	GLint getUniform(UniformID id) const { return id.index >= 0 ? uniformLocations[id.index] : -1; }
+
+	// Reads the uniform block called name from the given binding point.
+	// init() does this for the blocks in GLSL.h.
+	void bindUniformBlock(const std::string &name, GLuint binding);
+
+	// Lookups by name; these build a std::string and search a map
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
 
+	// How the last init() went: loaded from the cache or compiled, and how
+	// long submit() and finish() took, including reading the shader files
+	// but not the time the driver spent linking in the background
+	bool isFromCache() const { return fromCache; }
+	double getInitSeconds() const { return initSeconds; }
+
 protected:
 
 	std::string vShaderName;
@@ -37,10 +84,45 @@ protected:
 
 private:
 
+	enum class State { Empty, Submitted, Linked, Failed };
+
+	// A program object on its way from the shader sources to linked
+	struct Build
+	{
+		GLuint pid = 0;
+		GLuint vShader = 0;
+		GLuint fShader = 0;
+		bool fromCache = false;
+		bool retrievable = false;
+		uint64_t sourceHash = 0;
+	};
+
+	void startBuild(Build &build) const;
+	bool isBuildDone(const Build &build) const;
+	// Reports errors and frees the shaders; false if it did not link, in
+	// which case the program is deleted too
+	bool completeBuild(Build &build) const;
+	// Makes the built program the one that is bound and looked up
+	void adopt(const Build &build);
+	bool loadBinary(Build &build) const;
+	void saveBinary(const Build &build) const;
+	bool checkCompile(GLuint shader, const std::string &name, const char *stage) const;
+	GLint lookupAttribute(const std::string &name) const;
+	GLint lookupUniform(const std::string &name) const;
+
 	GLuint pid = 0;
-	std::map<std::string, GLint> attributes;
-	std::map<std::string, GLint> uniforms;
+	State state = State::Empty;
+	// Between submit() and finish(), or reload() and updateReload()
+	Build building;
+	bool reloading = false;
+	// Name -> index into the location arrays
+	std::map<std::string, int> attributes;
+	std::map<std::string, int> uniforms;
+	std::vector<GLint> attributeLocations;
+	std::vector<GLint> uniformLocations;
 	bool verbose = true;
+	bool fromCache = false;
+	double initSeconds = 0;
 
 };
 
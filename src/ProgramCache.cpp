@@ -0,0 +1,135 @@
+#include "ProgramCache.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+
+namespace ProgramCache
+{
+
+// Bump whenever the layout of the file or what Program::init() sets up
+// before linking (e.g. the attribute locations) changes.
+static const uint32_t FormatVersion = 1;
+
+struct Header
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint64_t driverHash;
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+};
+
+static bool enabled = true;
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(const char *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t hashString(const char *str, uint64_t hash)
+{
+	// Include the terminator, so that "ab" + "c" and "a" + "bc" differ
+	return hashBytes(str ? str : "", str ? strlen(str) + 1 : 1, hash);
+}
+
+static uint64_t driverHash()
+{
+	uint64_t hash = hashString((const char *) glGetString(GL_VENDOR), 14695981039346656037ull);
+	hash = hashString((const char *) glGetString(GL_RENDERER), hash);
+	return hashString((const char *) glGetString(GL_VERSION), hash);
+}
+
+void setEnabled(bool e)
+{
+	enabled = e;
+}
+
+bool isAvailable()
+{
+	if (!enabled || !GLAD_GL_ARB_get_program_binary)
+	{
+		return false;
+	}
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+string cacheName(const string &vShaderName, const string &fShaderName)
+{
+	const size_t slash = fShaderName.find_last_of("/\\");
+	const string fBase = slash == string::npos ? fShaderName : fShaderName.substr(slash + 1);
+	return vShaderName + "." + fBase + ".progcache";
+}
+
+uint64_t sourceHash(const string &vShaderSource, const string &fShaderSource)
+{
+	uint64_t hash = hashBytes((const char *) &FormatVersion, sizeof(FormatVersion));
+	hash = hashString(vShaderSource.c_str(), hash);
+	return hashString(fShaderSource.c_str(), hash);
+}
+
+bool read(const string &vShaderName, const string &fShaderName,
+	uint64_t sourceHash, GLenum &format, vector<char> &binary)
+{
+	MappedFile file;
+	if (!file.open(cacheName(vShaderName, fShaderName)) || file.size() < sizeof(Header))
+	{
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, file.data(), sizeof(Header));
+	if (memcmp(header.magic, "PRGC", 4) != 0 || header.version != FormatVersion ||
+		header.sourceHash != sourceHash || header.driverHash != driverHash())
+	{
+		return false;
+	}
+	if (file.size() != sizeof(Header) + header.binaryLength)
+	{
+		return false;
+	}
+
+	format = (GLenum) header.binaryFormat;
+	binary.assign(file.data() + sizeof(Header), file.data() + file.size());
+	return true;
+}
+
+bool write(const string &vShaderName, const string &fShaderName,
+	uint64_t sourceHash, GLenum format, const vector<char> &binary)
+{
+	Header header;
+	memcpy(header.magic, "PRGC", 4);
+	header.version = FormatVersion;
+	header.sourceHash = sourceHash;
+	header.driverHash = driverHash();
+	header.binaryFormat = (uint32_t) format;
+	header.binaryLength = (uint32_t) binary.size();
+
+	const string name = cacheName(vShaderName, fShaderName);
+	ofstream out(name.c_str(), ios::binary | ios::trunc);
+	if (!out)
+	{
+		cerr << "Could not write program cache: '" << name << "'" << endl;
+		return false;
+	}
+
+	out.write((const char *) &header, sizeof(Header));
+	out.write(binary.data(), binary.size());
+
+	return (bool) out;
+}
+
+}
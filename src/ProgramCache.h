@@ -0,0 +1,46 @@
+#pragma once
+#ifndef LAB471_PROGRAMCACHE_H_INCLUDED
+#define LAB471_PROGRAMCACHE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// Binary cache for linked shader programs (ARB_get_program_binary).
+//
+// The cache lives next to the vertex shader (<vert>.<frag>.progcache) and
+// holds a small header followed by the program binary exactly as the driver
+// returned it. The header records a hash of both shader sources and a hash
+// of the GL vendor, renderer and version strings, so editing a shader or
+// updating the driver invalidates the cache. A driver may still reject a
+// binary it wrote itself; Program::init() then compiles from source and
+// writes a new one.
+namespace ProgramCache
+{
+	// Turns the cache off, e.g. to time compiling from source (default on)
+	void setEnabled(bool enabled);
+
+	// Enabled, and the driver has at least one binary format. Needs a
+	// current context.
+	bool isAvailable();
+
+	// Path of the cache file that belongs to a pair of shaders
+	std::string cacheName(const std::string &vShaderName, const std::string &fShaderName);
+
+	// Hash of everything besides the driver that the binary depends on
+	uint64_t sourceHash(const std::string &vShaderSource, const std::string &fShaderSource);
+
+	// Fills format and binary from the cache. Returns false if there is no
+	// cache or it is out of date, in which case they are left untouched.
+	bool read(const std::string &vShaderName, const std::string &fShaderName,
+		uint64_t sourceHash, GLenum &format, std::vector<char> &binary);
+
+	// Writes the binary to the cache. Returns false if it cannot be written.
+	bool write(const std::string &vShaderName, const std::string &fShaderName,
+		uint64_t sourceHash, GLenum format, const std::vector<char> &binary);
+}
+
+#endif // LAB471_PROGRAMCACHE_H_INCLUDED
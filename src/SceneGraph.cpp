@@ -0,0 +1,86 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+
+const SceneGraph::Node SceneGraph::NoParent;
+
+void SceneGraph::clear()
+{
+	parents.clear();
+	firstChild.clear();
+	nextSibling.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	changed.clear();
+	updated.clear();
+}
+
+SceneGraph::Node SceneGraph::add(Node parent, const mat4 &local)
+{
+	const Node node = (Node) locals.size();
+	parents.push_back(parent);
+	firstChild.push_back(NoParent);
+	nextSibling.push_back(NoParent);
+	locals.push_back(local);
+	worlds.push_back(mat4(1.0f));
+	dirty.push_back(1);
+	changed.push_back(node);
+
+	if (parent != NoParent)
+	{
+		nextSibling[node] = firstChild[parent];
+		firstChild[parent] = node;
+	}
+	return node;
+}
+
+void SceneGraph::setLocal(Node node, const mat4 &local)
+{
+	locals[node] = local;
+	if (! dirty[node])
+	{
+		dirty[node] = 1;
+		changed.push_back(node);
+	}
+}
+
+size_t SceneGraph::update()
+{
+	// Parents have lower indices than their children, so in this order a
+	// changed parent brings its subtree up to date before any changed child
+	// in it is reached, and the child is then skipped
+	sort(changed.begin(), changed.end());
+
+	updated.clear();
+	for (Node root : changed)
+	{
+		if (! dirty[root])
+		{
+			continue;
+		}
+
+		pending.push_back(root);
+		while (! pending.empty())
+		{
+			const Node node = pending.back();
+			pending.pop_back();
+
+			const Node parent = parents[node];
+			worlds[node] = parent == NoParent ? locals[node] : worlds[parent] * locals[node];
+			dirty[node] = 0;
+			updated.push_back(node);
+
+			for (Node child = firstChild[node]; child != NoParent; child = nextSibling[child])
+			{
+				pending.push_back(child);
+			}
+		}
+	}
+	changed.clear();
+	return updated.size();
+}
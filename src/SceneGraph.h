@@ -0,0 +1,62 @@
+#pragma once
+#ifndef LAB471_SCENEGRAPH_H_INCLUDED
+#define LAB471_SCENEGRAPH_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// A retained transform hierarchy. Every node has a transform relative to its
+// parent, and its world matrix is kept from one update() to the next; only
+// nodes whose own transform changed, and the nodes below them, are
+// recomputed. The world matrices sit in one array in node order.
+class SceneGraph
+{
+
+public:
+
+	// Index of a node, and of its world matrix
+	typedef int Node;
+	static const Node NoParent = -1;
+
+	void clear();
+
+	// Parents have to be added before their children
+	Node add(Node parent, const glm::mat4 &local = glm::mat4(1.0f));
+
+	// Marks the node, and with it everything below it, for the next update()
+	void setLocal(Node node, const glm::mat4 &local);
+
+	const glm::mat4 &getLocal(Node node) const { return locals[node]; }
+	const glm::mat4 &getWorld(Node node) const { return worlds[node]; }
+	const glm::mat4 *getWorlds() const { return worlds.data(); }
+	size_t size() const { return locals.size(); }
+
+	// Recomputes the world matrices of the changed nodes and of everything
+	// below them. Returns how many nodes were recomputed.
+	size_t update();
+
+	// The nodes the last update() recomputed, so that data derived from the
+	// world matrices only has to follow those
+	const std::vector<Node> &getUpdated() const { return updated; }
+
+private:
+
+	std::vector<Node> parents;
+	std::vector<Node> firstChild;
+	std::vector<Node> nextSibling;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned char> dirty;
+
+	// Nodes that were changed since the last update(), and the nodes that
+	// update() still has to visit
+	std::vector<Node> changed;
+	std::vector<Node> pending;
+	std::vector<Node> updated;
+
+};
+
+#endif // LAB471_SCENEGRAPH_H_INCLUDED
@@ -1,8 +1,17 @@
 #include "Shape.h"
 #include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 
 #include "GLSL.h"
-#include "Program.h"
+#include "GLState.h"
+#include "InstanceBuffer.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "VertexPacking.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -10,6 +19,26 @@
 using namespace std;
 
 
+Shape::~Shape()
+{
+	unsigned int buffers[] = {eleBufID, posBufID, norBufID, texBufID};
+	for (unsigned int id : buffers)
+	{
+		if (id != 0)
+		{
+			GLState::deleteBuffers(1, &id);
+		}
+	}
+	unsigned int arrays[] = {vaoID, instVaoID};
+	for (unsigned int id : arrays)
+	{
+		if (id != 0)
+		{
+			GLState::deleteVertexArrays(1, &id);
+		}
+	}
+}
+
 void Shape::loadMesh(const string &meshName)
 {
 	// Load geometry
@@ -18,7 +47,7 @@ void Shape::loadMesh(const string &meshName)
 	vector<tinyobj::shape_t> shapes;
 	vector<tinyobj::material_t> objMaterials;
 	string errStr;
-	bool rc = tinyobj::LoadObj(shapes, objMaterials, errStr, meshName.c_str());
+	bool rc = tinyobj::LoadObjMapped(shapes, objMaterials, errStr, meshName.c_str());
 
 	if (! rc)
 	{
@@ -33,6 +62,22 @@ void Shape::loadMesh(const string &meshName)
 	}
 }
 
+void Shape::loadMeshCached(const string &meshName)
+{
+	if (MeshCache::read(meshName, posBuf, norBuf, texBuf, eleBuf))
+	{
+		return;
+	}
+
+	loadMesh(meshName);
+	if (posBuf.empty())
+	{
+		return;
+	}
+	resize();
+	MeshCache::write(meshName, posBuf, norBuf, texBuf, eleBuf);
+}
+
 void Shape::resize()
 {
 	float minX, minY, minZ;
@@ -96,16 +141,97 @@ void Shape::resize()
 	}
 }
 
+void Shape::optimize(bool overdraw)
+{
+	assert(vaoID == 0);
+
+	const MeshOptimizer::CacheStats before = MeshOptimizer::analyzeVertexCache(eleBuf, posBuf.size() / 3);
+
+	vector<size_t> clusters;
+	MeshOptimizer::reorderTriangles(eleBuf, posBuf.size() / 3, overdraw ? &clusters : nullptr);
+	if (overdraw)
+	{
+		MeshOptimizer::reorderForOverdraw(eleBuf, posBuf, clusters);
+	}
+	MeshOptimizer::reorderVertices(eleBuf, posBuf, norBuf, texBuf);
+
+	const MeshOptimizer::CacheStats after = MeshOptimizer::analyzeVertexCache(eleBuf, posBuf.size() / 3);
+
+	cacheReport.optimized = true;
+	cacheReport.acmrBefore = before.acmr;
+	cacheReport.atvrBefore = before.atvr;
+	cacheReport.acmrAfter = after.acmr;
+	cacheReport.atvrAfter = after.atvr;
+}
+
+void Shape::printCacheStats(const string &label) const
+{
+	if (cacheReport.optimized)
+	{
+		cout << label << ": ACMR " << cacheReport.acmrBefore << " -> " << cacheReport.acmrAfter
+			<< ", ATVR " << cacheReport.atvrBefore << " -> " << cacheReport.atvrAfter << endl;
+	}
+}
+
 void Shape::init()
 {
 	// Initialize the vertex array object
 	glGenVertexArrays(1, &vaoID);
-	glBindVertexArray(vaoID);
+	GLState::bindVertexArray(vaoID);
+
+	if (vertexFormat == VertexFormat::Separate)
+	{
+		initSeparate();
+	}
+	else
+	{
+		initPacked();
+	}
+
+	// Send the element array to the GPU
+	initIndices();
+
+	// The attribute layout and the element buffer stay in the VAO, draw()
+	// only has to bind it
+	bindAttributes();
+
+	// Unbind the arrays; the VAO first, so it keeps its element buffer
+	GLState::bindVertexArray(0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	eleCount = (int) eleBuf.size();
+
+	// Keep the bounds around, they are all that is left of posBuf once the
+	// CPU copies go away
+	if (! posBuf.empty())
+	{
+		boundsMin = boundsMax = glm::vec3(posBuf[0], posBuf[1], posBuf[2]);
+		for (size_t v = 1; v < posBuf.size() / 3; v++)
+		{
+			glm::vec3 p(posBuf[3*v+0], posBuf[3*v+1], posBuf[3*v+2]);
+			boundsMin = glm::min(boundsMin, p);
+			boundsMax = glm::max(boundsMax, p);
+		}
+	}
 
+	assert(glGetError() == GL_NO_ERROR);
+
+	if (gpuResidentOnly)
+	{
+		releaseCPUBuffers();
+	}
+}
+
+void Shape::initSeparate()
+{
 	// Send the position array to the GPU
 	glGenBuffers(1, &posBufID);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, posBufID);
 	glBufferData(GL_ARRAY_BUFFER, posBuf.size()*sizeof(float), posBuf.data(), GL_STATIC_DRAW);
+	posAttrib.buffer = posBufID;
+	posAttrib.size = 3;
+	posAttrib.type = GL_FLOAT;
 
 	// Send the normal array to the GPU
 	if (norBuf.empty())
@@ -115,8 +241,11 @@ void Shape::init()
 	else
 	{
 		glGenBuffers(1, &norBufID);
-		glBindBuffer(GL_ARRAY_BUFFER, norBufID);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, norBufID);
 		glBufferData(GL_ARRAY_BUFFER, norBuf.size()*sizeof(float), norBuf.data(), GL_STATIC_DRAW);
+		norAttrib.buffer = norBufID;
+		norAttrib.size = 3;
+		norAttrib.type = GL_FLOAT;
 	}
 
 	// Send the texture array to the GPU
@@ -127,71 +256,436 @@ void Shape::init()
 	else
 	{
 		glGenBuffers(1, &texBufID);
-		glBindBuffer(GL_ARRAY_BUFFER, texBufID);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, texBufID);
 		glBufferData(GL_ARRAY_BUFFER, texBuf.size()*sizeof(float), texBuf.data(), GL_STATIC_DRAW);
+		texAttrib.buffer = texBufID;
+		texAttrib.size = 2;
+		texAttrib.type = GL_FLOAT;
+	}
+
+	gpuPosBytes = posBuf.size() * sizeof(float);
+	gpuNorBytes = norBuf.size() * sizeof(float);
+	gpuTexBytes = texBuf.size() * sizeof(float);
+}
+
+void Shape::packVertices(VertexFormat format, PackedVertices &packed) const
+{
+	const size_t vertCount = posBuf.size() / 3;
+	const bool halfPos = format == VertexFormat::PackedHalf;
+	const bool hasNor = ! norBuf.empty() && norBuf.size() == posBuf.size();
+	const bool hasTex = ! texBuf.empty() && texBuf.size() / 2 == vertCount;
+
+	// unorm16 only covers [0,1], repeating texcoords have to stay float
+	bool texUnorm = hasTex;
+	for (size_t i = 0; texUnorm && i < texBuf.size(); i++)
+	{
+		texUnorm = texBuf[i] >= 0.0f && texBuf[i] <= 1.0f;
+	}
+
+	// Half positions are padded to four components, w = 1 is what the
+	// shaders expect anyway; everything stays 4 byte aligned
+	const size_t posSize = halfPos ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+	const size_t norSize = hasNor ? sizeof(uint32_t) : 0;
+	const size_t texSize = hasTex ? (texUnorm ? 2 * sizeof(uint16_t) : 2 * sizeof(float)) : 0;
+	const size_t stride = posSize + norSize + texSize;
+
+	packed.data.assign(vertCount * stride, 0);
+	for (size_t v = 0; v < vertCount; v++)
+	{
+		unsigned char *dst = &packed.data[v * stride];
+
+		if (halfPos)
+		{
+			const uint16_t pos[4] = {VertexPacking::floatToHalf(posBuf[3*v+0]),
+				VertexPacking::floatToHalf(posBuf[3*v+1]), VertexPacking::floatToHalf(posBuf[3*v+2]),
+				VertexPacking::floatToHalf(1.0f)};
+			memcpy(dst, pos, sizeof(pos));
+		}
+		else
+		{
+			memcpy(dst, &posBuf[3*v], 3 * sizeof(float));
+		}
+		dst += posSize;
+
+		if (hasNor)
+		{
+			const uint32_t nor = VertexPacking::packNormal(norBuf[3*v+0], norBuf[3*v+1], norBuf[3*v+2]);
+			memcpy(dst, &nor, sizeof(nor));
+			dst += norSize;
+		}
+
+		if (hasTex && texUnorm)
+		{
+			const uint16_t tex[2] = {VertexPacking::packUnorm16(texBuf[2*v+0]),
+				VertexPacking::packUnorm16(texBuf[2*v+1])};
+			memcpy(dst, tex, sizeof(tex));
+		}
+		else if (hasTex)
+		{
+			memcpy(dst, &texBuf[2*v], 2 * sizeof(float));
+		}
+	}
+
+	// A size of 0 marks an attribute the mesh does not have
+	packed.stride = stride;
+	packed.posSize = posSize;
+	packed.norSize = norSize;
+	packed.texSize = texSize;
+	packed.pos = AttribLayout();
+	packed.pos.size = halfPos ? 4 : 3;
+	packed.pos.type = halfPos ? GL_HALF_FLOAT : GL_FLOAT;
+	packed.pos.stride = (int) stride;
+
+	packed.nor = AttribLayout();
+	if (hasNor)
+	{
+		packed.nor.size = 4;
+		packed.nor.type = GL_INT_2_10_10_10_REV;
+		packed.nor.normalized = true;
+		packed.nor.stride = (int) stride;
+		packed.nor.offset = posSize;
+	}
+
+	packed.tex = AttribLayout();
+	if (hasTex)
+	{
+		packed.tex.size = 2;
+		packed.tex.type = texUnorm ? GL_UNSIGNED_SHORT : GL_FLOAT;
+		packed.tex.normalized = texUnorm;
+		packed.tex.stride = (int) stride;
+		packed.tex.offset = posSize + norSize;
+	}
+}
+
+void Shape::initPacked()
+{
+	PackedVertices packed;
+	packVertices(vertexFormat, packed);
+
+	// Everything lives in posBufID, the other two stay 0
+	glGenBuffers(1, &posBufID);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, posBufID);
+	glBufferData(GL_ARRAY_BUFFER, packed.data.size(), packed.data.data(), GL_STATIC_DRAW);
+
+	posAttrib = packed.pos;
+	posAttrib.buffer = posBufID;
+	if (packed.nor.size != 0)
+	{
+		norAttrib = packed.nor;
+		norAttrib.buffer = posBufID;
+	}
+	if (packed.tex.size != 0)
+	{
+		texAttrib = packed.tex;
+		texAttrib.buffer = posBufID;
+	}
+
+	const size_t vertCount = posBuf.size() / 3;
+	gpuPosBytes = vertCount * packed.posSize;
+	gpuNorBytes = vertCount * packed.norSize;
+	gpuTexBytes = vertCount * packed.texSize;
+}
+
+bool Shape::checkPacked(VertexFormat format, const string &label) const
+{
+	if (format == VertexFormat::Separate)
+	{
+		return true;
+	}
+
+	PackedVertices packed;
+	packVertices(format, packed);
+
+	// Worst error the format allows: half of one step of the encoding, with
+	// a little slack for the float math of the decode
+	const float norTolerance = 0.5f / 511.0f + 1e-6f;
+	const float texTolerance = 0.5f / 65535.0f + 1e-7f;
+
+	float posError = 0.0f, norError = 0.0f, texError = 0.0f;
+	size_t failures = 0;
+	for (size_t v = 0; v < posBuf.size() / 3; v++)
+	{
+		const unsigned char *src = &packed.data[v * packed.stride];
+
+		for (int c = 0; c < 3; c++)
+		{
+			const float expected = posBuf[3*v+c];
+			float decoded;
+			float tolerance = 0.0f;
+			if (packed.pos.type == GL_HALF_FLOAT)
+			{
+				uint16_t half;
+				memcpy(&half, src + c * sizeof(uint16_t), sizeof(half));
+				decoded = VertexPacking::halfToFloat(half);
+				// 11 significant bits, or half the smallest denormal
+				tolerance = std::max(std::abs(expected) / 2048.0f, 1.0f / (1 << 25));
+			}
+			else
+			{
+				memcpy(&decoded, src + c * sizeof(float), sizeof(decoded));
+			}
+			const float error = std::abs(decoded - expected);
+			posError = std::max(posError, error);
+			failures += error > tolerance;
+		}
+
+		if (packed.nor.size != 0)
+		{
+			uint32_t nor;
+			memcpy(&nor, src + packed.nor.offset, sizeof(nor));
+			float decoded[3];
+			VertexPacking::unpackNormal(nor, decoded[0], decoded[1], decoded[2]);
+			for (int c = 0; c < 3; c++)
+			{
+				const float expected = std::max(-1.0f, std::min(norBuf[3*v+c], 1.0f));
+				const float error = std::abs(decoded[c] - expected);
+				norError = std::max(norError, error);
+				failures += error > norTolerance;
+			}
+		}
+
+		if (packed.tex.size != 0)
+		{
+			for (int c = 0; c < 2; c++)
+			{
+				float decoded;
+				float tolerance = 0.0f;
+				if (packed.tex.type == GL_UNSIGNED_SHORT)
+				{
+					uint16_t unorm;
+					memcpy(&unorm, src + packed.tex.offset + c * sizeof(uint16_t), sizeof(unorm));
+					decoded = VertexPacking::unpackUnorm16(unorm);
+					tolerance = texTolerance;
+				}
+				else
+				{
+					memcpy(&decoded, src + packed.tex.offset + c * sizeof(float), sizeof(decoded));
+				}
+				const float error = std::abs(decoded - texBuf[2*v+c]);
+				texError = std::max(texError, error);
+				failures += error > tolerance;
+			}
+		}
+	}
+
+	cout << label << (format == VertexFormat::PackedHalf ? " (packed half)" : " (packed)")
+		<< ": largest error position " << posError << ", normal " << norError
+		<< ", texcoord " << texError << ", " << failures << " out of tolerance" << endl;
+	return failures == 0;
+}
+
+void Shape::initIndices()
+{
+	const size_t vertCount = posBuf.size() / 3;
+	vector<uint16_t> shortBuf;
+
+	if (vertCount <= 65536)
+	{
+		shortBuf.assign(eleBuf.begin(), eleBuf.end());
+	}
+	else if (meshletSplit && ! buildMeshlets(eleBuf, shortBuf, meshlets))
+	{
+		// Some triangle spans more than 65536 vertices, stay 32 bit
+		shortBuf.clear();
+		meshlets.clear();
 	}
 
-	// Send the element array to the GPU
 	glGenBuffers(1, &eleBufID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, eleBuf.size()*sizeof(unsigned int), eleBuf.data(), GL_STATIC_DRAW);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
+	if (! shortBuf.empty())
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortBuf.size()*sizeof(uint16_t), shortBuf.data(), GL_STATIC_DRAW);
+		eleType = GL_UNSIGNED_SHORT;
+		gpuEleBytes = shortBuf.size() * sizeof(uint16_t);
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, eleBuf.size()*sizeof(unsigned int), eleBuf.data(), GL_STATIC_DRAW);
+		eleType = GL_UNSIGNED_INT;
+		gpuEleBytes = eleBuf.size() * sizeof(unsigned int);
+	}
+}
 
-	// Unbind the arrays
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+// Greedily cuts the triangle list, in order, into runs whose vertices all lie
+// within 65536 of each other. Returns false if a single triangle does not fit,
+// or if the index order is so scattered that the meshlets come out tiny and
+// the extra draw calls would cost more than the 32 bit indices.
+bool Shape::buildMeshlets(const vector<unsigned int> &ele,
+	vector<uint16_t> &indices, vector<Meshlet> &meshlets)
+{
+	indices.clear();
+	indices.reserve(ele.size());
+	meshlets.clear();
 
-	assert(glGetError() == GL_NO_ERROR);
+	const size_t end = ele.size() / 3 * 3;
+	size_t start = 0;
+	unsigned int lo = 0, hi = 0;
+
+	auto emit = [&](size_t last)
+	{
+		Meshlet meshlet;
+		meshlet.offset = indices.size() * sizeof(uint16_t);
+		meshlet.count = (int) (last - start);
+		meshlet.baseVertex = (int) lo;
+		for (size_t i = start; i < last; i++)
+		{
+			indices.push_back((uint16_t) (ele[i] - lo));
+		}
+		meshlets.push_back(meshlet);
+	};
+
+	for (size_t t = 0; t < end; t += 3)
+	{
+		const unsigned int triLo = std::min(ele[t], std::min(ele[t+1], ele[t+2]));
+		const unsigned int triHi = std::max(ele[t], std::max(ele[t+1], ele[t+2]));
+		if (triHi - triLo > 0xffff)
+		{
+			return false;
+		}
+
+		if (t == start)
+		{
+			lo = triLo;
+			hi = triHi;
+		}
+		else if (std::max(hi, triHi) - std::min(lo, triLo) > 0xffff)
+		{
+			emit(t);
+			start = t;
+			lo = triLo;
+			hi = triHi;
+		}
+		else
+		{
+			lo = std::min(lo, triLo);
+			hi = std::max(hi, triHi);
+		}
+	}
+	if (start < end)
+	{
+		emit(end);
+	}
+
+	const size_t minTrianglesPerMeshlet = 4096;
+	return meshlets.size() <= 1 || meshlets.size() * minTrianglesPerMeshlet <= end / 3;
+}
+
+void Shape::releaseCPUBuffers()
+{
+	assert(vaoID != 0);
+
+	// swap() with empty vectors actually returns the memory
+	vector<unsigned int>().swap(eleBuf);
+	vector<float>().swap(posBuf);
+	vector<float>().swap(norBuf);
+	vector<float>().swap(texBuf);
+}
+
+Shape::MemoryStats Shape::getMemoryStats() const
+{
+	MemoryStats stats;
+
+	// Capacity rather than size, that is what the vectors actually hold on to
+	stats.cpuPos = posBuf.capacity() * sizeof(float);
+	stats.cpuNor = norBuf.capacity() * sizeof(float);
+	stats.cpuTex = texBuf.capacity() * sizeof(float);
+	stats.cpuEle = eleBuf.capacity() * sizeof(unsigned int);
+
+	stats.gpuPos = gpuPosBytes;
+	stats.gpuNor = gpuNorBytes;
+	stats.gpuTex = gpuTexBytes;
+	stats.gpuEle = gpuEleBytes;
+
+	return stats;
+}
+
+void Shape::printMemoryStats(const string &label) const
+{
+	MemoryStats stats = getMemoryStats();
+
+	cout << label << ": CPU " << stats.cpuTotal() << " bytes (pos " << stats.cpuPos
+		<< ", nor " << stats.cpuNor << ", tex " << stats.cpuTex << ", ele " << stats.cpuEle
+		<< "), GPU " << stats.gpuTotal() << " bytes (pos " << stats.gpuPos
+		<< ", nor " << stats.gpuNor << ", tex " << stats.gpuTex << ", ele " << stats.gpuEle
+		<< ")" << endl;
 }
 
-void Shape::draw(const shared_ptr<Program> prog) const
+void Shape::bindAttribute(unsigned int location, const AttribLayout &layout) const
 {
-	int h_pos, h_nor, h_tex;
-	h_pos = h_nor = h_tex = -1;
+	glEnableVertexAttribArray(location);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, layout.buffer);
+	glVertexAttribPointer(location, layout.size, layout.type, layout.normalized ? GL_TRUE : GL_FALSE,
+		layout.stride, (const void *)layout.offset);
+}
 
-	glBindVertexArray(vaoID);
+void Shape::bindAttributes() const
+{
 	// Bind position buffer
-	h_pos = prog->getAttribute("vertPos");
-	GLSL::enableVertexAttribArray(h_pos);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
-	glVertexAttribPointer(h_pos, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+	bindAttribute(GLSL::VertPosLocation, posAttrib);
 
 	// Bind normal buffer
-	h_nor = prog->getAttribute("vertNor");
-	if (h_nor != -1 && norBufID != 0)
+	if (norAttrib.buffer != 0)
 	{
-		GLSL::enableVertexAttribArray(h_nor);
-		glBindBuffer(GL_ARRAY_BUFFER, norBufID);
-		glVertexAttribPointer(h_nor, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+		bindAttribute(GLSL::VertNorLocation, norAttrib);
 	}
 
-	if (texBufID != 0)
+	// Bind texcoords buffer
+	if (texAttrib.buffer != 0)
 	{
-		// Bind texcoords buffer
-		h_tex = prog->getAttribute("vertTex");
-		if (h_tex != -1 && texBufID != 0)
-		{
-			GLSL::enableVertexAttribArray(h_tex);
-			glBindBuffer(GL_ARRAY_BUFFER, texBufID);
-			glVertexAttribPointer(h_tex, 2, GL_FLOAT, GL_FALSE, 0, (const void *)0);
-		}
+		bindAttribute(GLSL::VertTexLocation, texAttrib);
 	}
 
 	// Bind element buffer
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
+}
+
+void Shape::draw() const
+{
+	GLState::bindVertexArray(vaoID);
+	drawElements(1);
+}
+
+void Shape::drawInstanced(const InstanceBuffer &instances) const
+{
+	if (instances.size() == 0)
+	{
+		return;
+	}
 
-	// Draw
-	glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT, (const void *)0);
+	// A second VAO with the instance attributes on top of the mesh ones, set
+	// up again only if a different instance buffer comes along
+	if (instVaoID == 0 || instVaoBuffer != instances.getBufferID())
+	{
+		if (instVaoID == 0)
+		{
+			glGenVertexArrays(1, &instVaoID);
+		}
+		GLState::bindVertexArray(instVaoID);
+		bindAttributes();
+		instances.bindAttributes();
+		instVaoBuffer = instances.getBufferID();
+	}
+
+	GLState::bindVertexArray(instVaoID);
+	drawElements((int) instances.size());
+}
 
-	// Disable and unbind
-	if (h_tex != -1)
+void Shape::drawElements(int instanceCount) const
+{
+	if (meshlets.empty() && instanceCount == 1)
+	{
+		glDrawElements(GL_TRIANGLES, eleCount, eleType, (const void *)0);
+	}
+	else if (meshlets.empty())
 	{
-		GLSL::disableVertexAttribArray(h_tex);
+		glDrawElementsInstanced(GL_TRIANGLES, eleCount, eleType, (const void *)0, instanceCount);
 	}
-	if (h_nor != -1)
+	else
 	{
-		GLSL::disableVertexAttribArray(h_nor);
+		for (const Meshlet &meshlet : meshlets)
+		{
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, meshlet.count, GL_UNSIGNED_SHORT,
+				(const void *)meshlet.offset, instanceCount, meshlet.baseVertex);
+		}
 	}
-	GLSL::disableVertexAttribArray(h_pos);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
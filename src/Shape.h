@@ -6,22 +6,150 @@
 
 #include <string>
 #include <vector>
-#include <memory>
+#include <cstdint>
 
-class Program;
+#include <glm/glm.hpp>
+
+class InstanceBuffer;
 
 class Shape
 {
 
 public:
 
+	Shape() {}
+	~Shape();
+
+	// Owns GL objects, so it cannot be copied
+	Shape(const Shape&) = delete;
+	Shape& operator= (const Shape&) = delete;
+
 	void loadMesh(const std::string &meshName);
+	// loadMesh() followed by resize(), served from a binary cache next to the
+	// .obj when it is up to date (see MeshCache.h)
+	void loadMeshCached(const std::string &meshName);
 	void init();
 	void resize();
-	void draw(const std::shared_ptr<Program> prog) const;
+
+	// Reorders the triangles and vertices for the post-transform vertex cache
+	// (see MeshOptimizer.h), optionally sorting triangle clusters to cut down
+	// on overdraw. Has to be called before init().
+	void optimize(bool overdraw = false);
+	void printCacheStats(const std::string &label) const;
+
+	// Layout of the vertex data on the GPU, has to be set before init().
+	// Separate: one float buffer per attribute (default).
+	// Packed: a single interleaved buffer with float positions, normals in
+	// 10_10_10_2 and texcoords in unorm16 (float if they fall outside [0,1]).
+	// PackedHalf: like Packed, with half float positions.
+	// Normals are 10_10_10_2 in both packed formats, not octahedral snorm16:
+	// the vertex fetch decodes 10_10_10_2 to the same vec3 vertNor the
+	// shaders read in the Separate layout, octahedral would need a decode in
+	// every vertex shader.
+	enum class VertexFormat { Separate, Packed, PackedHalf };
+	void setVertexFormat(VertexFormat format) { vertexFormat = format; }
+	VertexFormat getVertexFormat() const { return vertexFormat; }
+
+	// Packs the loaded vertices the way init() would for format, decodes them
+	// again the way the vertex fetch does and compares them to the float
+	// data. Prints the largest errors; returns false if any value is off by
+	// more than the precision of its encoding. Needs no GL context.
+	bool checkPacked(VertexFormat format, const std::string &label) const;
+
+	// Indices are 16 bit whenever the mesh has at most 65536 vertices. Larger
+	// meshes keep 32 bit indices, unless this is set before init(): then they
+	// are split into meshlets of 16 bit indices, each drawn with its own base
+	// vertex.
+	void setMeshletSplit(bool split) { meshletSplit = split; }
+	size_t getMeshletCount() const { return meshlets.size(); }
+
+	// The attribute layout lives in the VAO at the fixed locations in GLSL.h,
+	// so a draw is just binding it and drawing, with whatever program is bound
+	void draw() const;
+	// One draw call for all instances; the bound program takes the per
+	// instance data as described in InstanceBuffer.h
+	void drawInstanced(const InstanceBuffer &instances) const;
+
+	// Frees the CPU copies of the mesh data; only valid after init()
+	void releaseCPUBuffers();
+
+	// When set before init(), the CPU copies are released as soon as they are
+	// uploaded. Only the element count and the bounds are kept.
+	void setGPUResidentOnly(bool resident) { gpuResidentOnly = resident; }
+	bool isGPUResidentOnly() const { return gpuResidentOnly; }
+
+	// Object space bounding box, valid after init()
+	const glm::vec3 &getBoundsMin() const { return boundsMin; }
+	const glm::vec3 &getBoundsMax() const { return boundsMax; }
+
+	// Per buffer breakdown of where the mesh data lives
+	struct MemoryStats
+	{
+		size_t cpuPos = 0, cpuNor = 0, cpuTex = 0, cpuEle = 0;
+		size_t gpuPos = 0, gpuNor = 0, gpuTex = 0, gpuEle = 0;
+
+		size_t cpuTotal() const { return cpuPos + cpuNor + cpuTex + cpuEle; }
+		size_t gpuTotal() const { return gpuPos + gpuNor + gpuTex + gpuEle; }
+	};
+
+	MemoryStats getMemoryStats() const;
+	void printMemoryStats(const std::string &label) const;
+
+	// Bytes held in CPU memory and in GPU buffers
+	size_t getCPUBytes() const { return getMemoryStats().cpuTotal(); }
+	size_t getGPUBytes() const { return getMemoryStats().gpuTotal(); }
 
 private:
 
+	// How draw() feeds one attribute; buffer is 0 if the mesh does not have it
+	struct AttribLayout
+	{
+		unsigned int buffer = 0;
+		int size = 0;
+		unsigned int type = 0;
+		bool normalized = false;
+		int stride = 0;
+		size_t offset = 0;
+	};
+
+	// A run of 16 bit indices, relative to baseVertex
+	struct Meshlet
+	{
+		size_t offset = 0; // in bytes
+		int count = 0;
+		int baseVertex = 0;
+	};
+
+	// Vertex cache behavior before and after optimize()
+	struct CacheReport
+	{
+		bool optimized = false;
+		float acmrBefore = 0.0f, atvrBefore = 0.0f;
+		float acmrAfter = 0.0f, atvrAfter = 0.0f;
+	};
+
+	// Interleaved vertex data of the packed formats, with the layout of each
+	// attribute in it (buffer still 0, size 0 if the mesh lacks it) and the
+	// bytes it takes per vertex
+	struct PackedVertices
+	{
+		std::vector<unsigned char> data;
+		size_t stride = 0;
+		AttribLayout pos, nor, tex;
+		size_t posSize = 0, norSize = 0, texSize = 0;
+	};
+
+	static bool buildMeshlets(const std::vector<unsigned int> &ele,
+		std::vector<uint16_t> &indices, std::vector<Meshlet> &meshlets);
+
+	void initSeparate();
+	void packVertices(VertexFormat format, PackedVertices &packed) const;
+	void initPacked();
+	void initIndices();
+	void bindAttribute(unsigned int location, const AttribLayout &layout) const;
+	void bindAttributes() const;
+	void drawElements(int instanceCount) const;
+
 	std::vector<unsigned int> eleBuf;
 	std::vector<float> posBuf;
 	std::vector<float> norBuf;
@@ -32,6 +160,29 @@ private:
 	unsigned int norBufID = 0;
 	unsigned int texBufID = 0;
 	unsigned int vaoID = 0;
+	// VAO for drawInstanced() and the instance buffer it is set up for
+	mutable unsigned int instVaoID = 0;
+	mutable unsigned int instVaoBuffer = 0;
+
+	VertexFormat vertexFormat = VertexFormat::Separate;
+	AttribLayout posAttrib;
+	AttribLayout norAttrib;
+	AttribLayout texAttrib;
+
+	int eleCount = 0;
+	unsigned int eleType = 0;
+	bool meshletSplit = false;
+	std::vector<Meshlet> meshlets;
+	CacheReport cacheReport;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	bool gpuResidentOnly = false;
+
+	// Sizes of the uploaded buffers, in bytes
+	size_t gpuPosBytes = 0;
+	size_t gpuNorBytes = 0;
+	size_t gpuTexBytes = 0;
+	size_t gpuEleBytes = 0;
 
 };
 
@@ -0,0 +1,117 @@
+#include "Simulation.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace glm;
+
+
+const int Simulation::TickRate;
+const int Simulation::FlightTicks;
+
+void Simulation::reset(size_t targets, size_t ballCount)
+{
+	positions.resize(targets);
+	for (size_t i = 0; i < targets; i++)
+	{
+		positions[i] = vec3(rand() % 20 - 10, rand() % 20 - 10, rand() % 20 - 10);
+	}
+	hit.assign(targets, 0);
+	explosion.assign(targets, 0.0f);
+	prevExplosion.assign(targets, 0.0f);
+	balls.assign(ballCount, Ball());
+	ticks = 0;
+}
+
+void Simulation::step(double dt)
+{
+	const float tickCount = (float) (dt * TickRate);
+	prevExplosion = explosion;
+
+	for (Ball &ball : balls)
+	{
+		ball.prevTime = ball.time;
+
+		if (ball.charging)
+		{
+			ball.speed += 0.001f * tickCount;
+			ball.explode = ball.speed / 2.0f;
+			ball.direction = ball.aim;
+		}
+		else if (ball.speed > 0.0)
+		{
+			ball.shoot = ball.speed;
+			if (ball.time > FlightTicks)
+			{
+				// The last target hit is whole again, without drawing the
+				// way back from the end of the flight
+				hit[ball.lastHit] = 0;
+				explosion[ball.lastHit] = 0;
+				prevExplosion[ball.lastHit] = 0;
+				ball.time = 0;
+				ball.prevTime = 0;
+				ball.shoot = 0;
+				ball.speed = 0;
+				ball.explode = 0;
+				ball.landed = true;
+			}
+			else
+			{
+				ball.time += tickCount;
+			}
+		}
+
+		ball.position = calculateTrajectory(ball.direction * ball.shoot, -.0018, ball.time) / 10.0f;
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			if (checkCollision(ball.position, positions[i] + vec3(.5, .5, .5)))
+			{
+				hit[i] = 1;
+				ball.lastHit = (int) i;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		if (hit[i] == 1)
+		{
+			explosion[i] += 0.5f * tickCount;
+		}
+	}
+	ticks++;
+}
+
+float Simulation::explosionAt(size_t target, float alpha) const
+{
+	return prevExplosion[target] + (explosion[target] - prevExplosion[target]) * alpha;
+}
+
+vec3 Simulation::flightAt(const Ball &ball, float alpha) const
+{
+	return calculateTrajectory(ball.direction * ball.shoot, -.0018,
+		ball.prevTime + (ball.time - ball.prevTime) * alpha);
+}
+
+vec3 Simulation::calculateTrajectory(vec3 initialVelocity, float gravityInY, float time)
+{
+	vec3 outDisplacement;
+
+	outDisplacement.x = initialVelocity.x * time;
+	outDisplacement.z = initialVelocity.z * time;
+
+	float timeSquared = time * time;
+	outDisplacement.y = (initialVelocity.y * time) + 0.5*(gravityInY * timeSquared);
+	return outDisplacement;
+}
+
+bool Simulation::checkCollision(vec3 ball, vec3 cube)
+{
+	float dx = ball.x - cube.x;
+	float dy = ball.y - cube.y;
+	float dz = ball.z - cube.z;
+	float distance = sqrt(dx*dx + dy*dy + dz*dz);
+
+	return distance <= 1.3f;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef LAB471_SIMULATION_H_INCLUDED
+#define LAB471_SIMULATION_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// The game without any drawing: balls are charged up, thrown, and blow up
+// the targets they come close to. Everything advances in steps of step().
+// Game time is counted in ticks of 1/TickRate seconds, the step length the
+// game was tuned for; a step of dt seconds advances it by dt * TickRate
+// ticks, so the game runs at the same speed at any step rate. Only glm is
+// needed, so this also builds into the headless FinalProjectSim.
+class Simulation
+{
+
+public:
+
+	static const int TickRate = 60;
+
+	// Ticks a thrown ball flies before it comes back
+	static const int FlightTicks = 500;
+
+	struct Ball
+	{
+		// Input: held down to charge a throw, and where to throw it
+		bool charging = false;
+		glm::vec3 aim = glm::vec3(0.0f);
+
+		glm::vec3 direction = glm::vec3(0.0f);
+		float speed = 0.0f;     // charged so far
+		float shoot = 0.0f;     // speed of the throw, while in flight
+		float explode = 0.0f;   // how hard the targets it hits fly apart
+		float time = 0.0f;      // ticks since the throw
+		float prevTime = 0.0f;
+		glm::vec3 position = glm::vec3(0.0f);
+		int lastHit = 0;
+
+		// Set when the ball comes back after a throw, for whoever wants to
+		// react to that; step() does not clear it
+		bool landed = false;
+	};
+
+	// The targets, one entry per target in every array
+	std::vector<glm::vec3> positions;
+	std::vector<int> hit;
+	std::vector<float> explosion;
+	std::vector<float> prevExplosion;
+
+	std::vector<Ball> balls;
+
+	// Steps taken since reset()
+	size_t ticks = 0;
+
+	// Puts the targets at random positions on the integer grid in
+	// [-10, 10)^3, none of them hit, and all balls at rest
+	void reset(size_t targets, size_t ballCount);
+
+	// Advances the game by dt seconds
+	void step(double dt);
+
+	// State alpha of the way from the previous step to the current one, for
+	// drawing between steps
+	float explosionAt(size_t target, float alpha) const;
+	glm::vec3 flightAt(const Ball &ball, float alpha) const;
+
+	static glm::vec3 calculateTrajectory(glm::vec3 initialVelocity, float gravityInY, float time);
+	static bool checkCollision(glm::vec3 ball, glm::vec3 cube);
+
+};
+
+#endif // LAB471_SIMULATION_H_INCLUDED
@@ -1,5 +1,6 @@
 #include "Texture.h"
 #include "GLSL.h"
+#include "GLState.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
@@ -17,7 +18,10 @@ Texture::Texture() :
 
 Texture::~Texture()
 {
-	
+	if (tid != 0)
+	{
+		GLState::deleteTextures(1, &tid);
+	}
 }
 
 void Texture::init()
@@ -41,7 +45,7 @@ void Texture::init()
 	// Generate a texture buffer object
 	glGenTextures(1, &tid);
 	// Bind the current texture to be the newly generated texture object
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::bindTexture(GL_TEXTURE_2D, tid);
 	// Load the actual texture data
 	// Base level is 0, number of channels is 3, and border is 0.
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
@@ -54,7 +58,7 @@ void Texture::init()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	// Unbind
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
 	// Free image, since the data is now on the GPU
 	stbi_image_free(data);
 }
@@ -62,20 +66,20 @@ void Texture::init()
 void Texture::setWrapModes(GLint wrapS, GLint wrapT)
 {
 	// Must be called after init()
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::bindTexture(GL_TEXTURE_2D, tid);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
 }
 
 void Texture::bind(GLint handle)
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::activeTexture(GL_TEXTURE0 + unit);
+	GLState::bindTexture(GL_TEXTURE_2D, tid);
 	glUniform1i(handle, unit);
 }
 
 void Texture::unbind()
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::activeTexture(GL_TEXTURE0 + unit);
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
 }
@@ -10,6 +10,9 @@ class Texture
 public:
 	Texture();
 	virtual ~Texture();
+	// Owns a GL texture, so it cannot be copied
+	Texture(const Texture&) = delete;
+	Texture& operator= (const Texture&) = delete;
 	void setFilename(const std::string &f) { filename = f; }
 	void init();
 	void setUnit(GLint u) { unit = u; }
@@ -0,0 +1,38 @@
+#include "UniformBuffer.h"
+
+#include <cassert>
+
+#include "GLSL.h"
+#include "GLState.h"
+
+
+UniformBuffer::~UniformBuffer()
+{
+	if (bufID != 0)
+	{
+		GLState::deleteBuffers(1, &bufID);
+	}
+}
+
+void UniformBuffer::init(unsigned int binding, size_t size)
+{
+	assert(bufID == 0);
+
+	bufSize = size;
+	glGenBuffers(1, &bufID);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, bufID);
+	glBufferData(GL_UNIFORM_BUFFER, bufSize, nullptr, GL_DYNAMIC_DRAW);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, binding, bufID);
+}
+
+void UniformBuffer::update(const void *data, size_t size)
+{
+	assert(size == bufSize);
+
+	// Respecifying the whole buffer lets the driver hand out fresh storage
+	// instead of waiting for last frame's draws
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, bufID);
+	glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#ifndef LAB471_UNIFORMBUFFER_H_INCLUDED
+#define LAB471_UNIFORMBUFFER_H_INCLUDED
+
+#include <cstddef>
+
+
+// A uniform buffer object attached to one of the binding points in GLSL.h.
+// Every program that declares the matching block reads from it, so data
+// shared by all programs is uploaded once instead of once per program and
+// draw. The contents have to follow the std140 layout of the block.
+class UniformBuffer
+{
+
+public:
+
+	UniformBuffer() {}
+	~UniformBuffer();
+
+	// Owns a GL buffer, so it cannot be copied
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator= (const UniformBuffer&) = delete;
+
+	// Creates the buffer with room for size bytes and attaches it
+	void init(unsigned int binding, size_t size);
+
+	// Replaces the contents; size has to match init()
+	void update(const void *data, size_t size);
+
+private:
+
+	unsigned int bufID = 0;
+	size_t bufSize = 0;
+
+};
+
+#endif // LAB471_UNIFORMBUFFER_H_INCLUDED
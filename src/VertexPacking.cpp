@@ -0,0 +1,214 @@
+#include "VertexPacking.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+
+namespace VertexPacking
+{
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t absBits = bits & 0x7fffffff;
+
+	if (absBits >= 0x7f800000)
+	{
+		// Inf stays inf, NaN stays a (quiet) NaN
+		return (uint16_t) (sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0));
+	}
+	if (absBits >= 0x477ff000)
+	{
+		// Rounds to something above the largest half
+		return (uint16_t) (sign | 0x7c00);
+	}
+	if (absBits < 0x38800000)
+	{
+		// Half denormal (or zero): shift the mantissa into place with
+		// rounding. Below 2^-25, half of the smallest denormal, everything
+		// rounds to zero, and the shifts below would run past 32 bits.
+		const int shift = 113 - (int) (absBits >> 23);
+		if (shift > 11)
+		{
+			return (uint16_t) sign;
+		}
+		const uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+		uint32_t half = mantissa >> (shift + 13);
+		const uint32_t rest = mantissa & ((1u << (shift + 13)) - 1);
+		const uint32_t halfway = 1u << (shift + 12);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+		{
+			half++;
+		}
+		return (uint16_t) (sign | half);
+	}
+
+	// Normal: rebias the exponent and round the mantissa; a carry out of the
+	// mantissa correctly bumps the exponent
+	uint32_t half = (absBits - 0x38000000) >> 13;
+	const uint32_t rest = absBits & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	return (uint16_t) (sign | half);
+}
+
+float halfToFloat(uint16_t half)
+{
+	const uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1f;
+	const uint32_t mantissa = half & 0x3ff;
+
+	if (exponent == 0)
+	{
+		// Zero or denormal, exact in float
+		const float value = ldexpf((float) mantissa, -24);
+		return sign ? -value : value;
+	}
+
+	uint32_t bits;
+	if (exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint32_t packNormal(float x, float y, float z)
+{
+	const float v[3] = {x, y, z};
+	uint32_t packed = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const float c = v[i] < -1.0f ? -1.0f : (v[i] > 1.0f ? 1.0f : v[i]);
+		const int q = (int) lrintf(c * 511.0f);
+		packed |= ((uint32_t) q & 0x3ff) << (10 * i);
+	}
+	return packed;
+}
+
+void unpackNormal(uint32_t packed, float &x, float &y, float &z)
+{
+	float v[3];
+	for (int i = 0; i < 3; i++)
+	{
+		// Sign extend the 10 bit field; -512 clamps to -1 like GL does
+		int q = (int) ((packed >> (10 * i)) & 0x3ff);
+		q = q >= 512 ? q - 1024 : q;
+		v[i] = max(q / 511.0f, -1.0f);
+	}
+	x = v[0];
+	y = v[1];
+	z = v[2];
+}
+
+uint16_t packUnorm16(float value)
+{
+	return (uint16_t) lrintf(value * 65535.0f);
+}
+
+float unpackUnorm16(uint16_t value)
+{
+	return value / 65535.0f;
+}
+
+// True if half is the correctly rounded half of value, which has to be
+// finite. Distances are exact in double.
+static bool isNearestHalf(float value, uint16_t half)
+{
+	if ((half & 0x8000) != (signbit(value) ? 0x8000 : 0))
+	{
+		return false;
+	}
+	const double v = fabs((double) value);
+	const uint16_t mag = half & 0x7fff;
+
+	// Halfway between the largest half and the next power of two is where
+	// rounding goes to inf
+	if (v >= 65520.0)
+	{
+		return mag == 0x7c00;
+	}
+	if (mag >= 0x7c00)
+	{
+		return false;
+	}
+
+	const double d = fabs(v - halfToFloat(mag));
+	const double below = mag > 0 ? fabs(v - halfToFloat((uint16_t) (mag - 1))) : INFINITY;
+	const double above = mag < 0x7bff ? fabs(v - halfToFloat((uint16_t) (mag + 1))) : INFINITY;
+	if (d > below || d > above)
+	{
+		return false;
+	}
+	// A tie has to go to the even one
+	return (d != below && d != above) || (mag & 1) == 0;
+}
+
+bool checkHalfConversion()
+{
+	size_t checked = 0;
+	size_t failures = 0;
+	auto check = [&](float value)
+	{
+		const uint16_t half = floatToHalf(value);
+		checked++;
+		if (! isNearestHalf(value, half))
+		{
+			if (failures++ < 10)
+			{
+				cout << "floatToHalf(" << value << ") = 0x" << hex << half << dec
+					<< ", not the nearest half" << endl;
+			}
+		}
+	};
+
+	// Every half, as a float, comes back unchanged
+	for (uint32_t h = 0; h < 0x10000; h++)
+	{
+		const bool nan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+		if (! nan && floatToHalf(halfToFloat((uint16_t) h)) != h)
+		{
+			if (failures++ < 10)
+			{
+				cout << "Half 0x" << hex << h << dec << " does not survive the round trip" << endl;
+			}
+		}
+	}
+
+	// Every 7th float from 2^-27 up to where the denormal halves end, and
+	// every 61st float of the whole finite range, both signs
+	for (uint32_t bits = 0; bits < 0x7f800000; bits += (bits >= 0x32000000 && bits < 0x38800000) ? 7 : 61)
+	{
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		check(value);
+		check(-value);
+	}
+
+	// Cases that used to shift a 32 bit value by 32 or more bits
+	const float tiny[] = {1e-10f, 3e-11f, 1e-11f, 1e-30f, 1e-45f, 2.9802322e-08f, 2.9802326e-08f};
+	for (float value : tiny)
+	{
+		check(value);
+		check(-value);
+	}
+
+	cout << "Half conversion: " << checked << " floats checked, " << failures << " wrong" << endl;
+	return failures == 0;
+}
+
+}
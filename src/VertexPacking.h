@@ -0,0 +1,33 @@
+#pragma once
+#ifndef LAB471_VERTEXPACKING_H_INCLUDED
+#define LAB471_VERTEXPACKING_H_INCLUDED
+
+#include <cstdint>
+
+
+// Encoders for the quantized vertex attributes of Shape's packed layouts,
+// and the matching decoders, which do on the CPU what the vertex fetch does
+// on the GPU.
+namespace VertexPacking
+{
+	// IEEE half float, rounded to nearest even. Values too large for a half
+	// become inf, values below half of the smallest half denormal become a
+	// zero of the same sign.
+	uint16_t floatToHalf(float value);
+	float halfToFloat(uint16_t half);
+
+	// Unit vector in GL_INT_2_10_10_10_REV, as signed normalized values; w = 0
+	uint32_t packNormal(float x, float y, float z);
+	void unpackNormal(uint32_t packed, float &x, float &y, float &z);
+
+	// [0, 1] in 16 bit unsigned normalized
+	uint16_t packUnorm16(float value);
+	float unpackUnorm16(uint16_t value);
+
+	// Checks floatToHalf() against the correctly rounded half of every half
+	// and of floats over the whole range, printing what does not match.
+	// Returns true if everything does.
+	bool checkHalfConversion();
+}
+
+#endif // LAB471_VERTEXPACKING_H_INCLUDED
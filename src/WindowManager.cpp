@@ -45,6 +45,10 @@ bool WindowManager::init(int const width, int const height)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+#ifdef OPENGL_ERROR_CHECKS_DEBUG
+	// Lets the driver report errors through KHR_debug, see GLSL::initErrorReporting()
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 	// Create a windowed mode window and its OpenGL context.
 	windowHandle = glfwCreateWindow(width, height, "openGL program", nullptr, nullptr);
@@ -65,6 +69,7 @@ bool WindowManager::init(int const width, int const height)
 
 	std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 	std::cout << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
+	GLSL::initErrorReporting();
 
 	// Set vsync
 	glfwSwapInterval(1);
@@ -8,12 +8,34 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <limits>
+#include <stack>
+#include <thread>
 #include <glad/glad.h>
 
 #include "GLSL.h"
+#include "GLCallCounter.h"
+#include "FileWatcher.h"
+#include "Frustum.h"
+#include "GLState.h"
 #include "Program.h"
+#include "ProgramCache.h"
+#include "SceneGraph.h"
+#include "Simulation.h"
 #include "MatrixStack.h"
 #include "Shape.h"
+#include "MeshLibrary.h"
+#include "MeshOptimizer.h"
+#include "InstanceBuffer.h"
+#include "UniformBuffer.h"
+#include "VertexPacking.h"
 #include "WindowManager.h"
 #include "GLTextureWriter.h"
 
@@ -27,10 +49,57 @@
 using namespace std;
 using namespace glm;
 
-vector<vec3> positions(20);
-vector<int> hit(20);
-vector<float> explosion(20);
-vec3 ballPos;
+// std140 mirror of the Frame uniform block (see GLSL.h)
+struct FrameConstants
+{
+    mat4 P;
+    mat4 view;
+    vec4 eyePos;
+};
+
+// std140 mirror of the Materials uniform block; the shaders index it with
+// the material of the draw or of the instance
+struct MaterialConstants
+{
+    vec4 MatAmb[4];
+    vec4 MatDif[4];
+};
+
+const MaterialConstants materials = {
+    {
+        vec4(0.02f, 0.04f, 0.2f, 1),           //shiny blue plastic
+        vec4(0.13f, 0.13f, 0.14f, 1),          // flat grey
+        vec4(0.3294f, 0.2235f, 0.02745f, 1),   //brass
+        vec4(0.1913f, 0.0735f, 0.0225f, 1)     //copper
+    },
+    {
+        vec4(0.0f, 0.16f, 0.9f, 1),
+        vec4(0.3f, 0.3f, 0.4f, 1),
+        vec4(0.7804f, 0.5686f, 0.11373f, 1),
+        vec4(0.7038f, 0.27048f, 0.0828f, 1)
+    }
+};
+
+// The 8 cube fragments of a target: where they sit, how far the target's
+// position pushes them when it explodes, and how they tumble
+struct TargetFragment
+{
+    vec3 offset;
+    vec3 spread;
+    float spin[2];
+    vec3 axis[2];
+};
+
+const TargetFragment targetFragments[8] = {
+    {vec3(0, 0, 0),       vec3(0, 0, 0),          {1, 1},   {vec3(0, 1, 0), vec3(0, 0, 1)}},
+    {vec3(0.1, 0, 0),     vec3(0.2, 0, 0),        {-1, 1},  {vec3(1, 0, 0), vec3(0, 0, 1)}},
+    {vec3(0, 0.1, 0),     vec3(0, 0.2, 0),        {1, -1},  {vec3(0, 1, 0), vec3(1, 0, 0)}},
+    {vec3(0, 0, 0.1),     vec3(0, 0, 0.2),        {-1, -1}, {vec3(1, 0, 0), vec3(0, 1, 0)}},
+    {vec3(0.1, 0, 0.1),   vec3(0.2, 0, 0.2),      {1, -1},  {vec3(0, 0, 1), vec3(0, 1, 0)}},
+    {vec3(0.1, 0.1, 0.1), vec3(0.2, 0.1, 0.2),    {1, 1},   {vec3(1, 0, 0), vec3(0, 0, 1)}},
+    {vec3(0, 0.1, 0.1),   vec3(0, 0.2, 0.2),      {-1, -1}, {vec3(0, 0, 1), vec3(1, 0, 0)}},
+    {vec3(0.1, 0.1, 0),   vec3(0.2, 0.2, 0),      {-1, 1},  {vec3(0, 1, 0), vec3(0, 0, 1)}}
+};
 
 
 class Application : public EventCallbacks
@@ -39,16 +108,22 @@ class Application : public EventCallbacks
 public:
     
     // Public variables
-    float time = 0;
-    float speed = 0;
     float theta = 0;
     float phi = 0;
     float radius = 1;
-    float x,y,z;
-    float xs,ys,zs;
+    float x = 0, y = 0, z = 0;
     const float PI = 3.14159;
-    float shoot = 0;
-    float explode = 0;
+    
+    // The targets and the player's ball (ball 0). The game advances in fixed
+    // steps of 1/simRate seconds, however often frames are rendered, and at
+    // the same speed for any simRate. Frames are drawn simAlpha of the way
+    // from the previous step to the current one.
+    Simulation sim;
+    size_t targetCount = 20;
+    double simRate = 60.0;
+    double simClock = -1.0;
+    double simAccumulator = 0.0;
+    float simAlpha = 1.0f;
     
     WindowManager * windowManager = nullptr;
     
@@ -56,12 +131,61 @@ public:
     std::shared_ptr<Program> prog;
     std::shared_ptr<Program> texProg;
     std::shared_ptr<Program> cubeProg;
+    std::shared_ptr<Program> instProg;
+    
+    // Uniform ids, so render() does not look uniforms up by name
+    Program::UniformID progMV, progMaterial;
+    Program::UniformID texTexBuf, texDir;
+    Program::UniformID cubeV, cubeM;
+    
+    // Matrix stacks for render(), reset every frame instead of reallocated
+    shared_ptr<MatrixStack> P = make_shared<MatrixStack>();
+    shared_ptr<MatrixStack> MV = make_shared<MatrixStack>();
+    
+    // Edited shaders are recompiled while the app keeps running
+    bool hotReload = true;
+    FileWatcher shaderFiles;
+    
+    // Per frame camera data and the material table, shared by all programs
+    UniformBuffer frameBlock;
+    UniformBuffer materialBlock;
     shared_ptr<Shape> cube;
     
     // Shape to be used (from obj file)
     shared_ptr<Shape> shape;
     shared_ptr<Shape> target;
     
+    // Meshes shared between shapes
+    MeshLibrary meshes;
+    Shape::VertexFormat vertexFormat = Shape::VertexFormat::Separate;
+    bool optimizeMeshes = false;
+    bool optimizeOverdraw = false;
+    
+    // All target fragments go out in one instanced draw, unless this is off.
+    // Fragment k of the scene below is instance k; only the ones that moved
+    // are written again.
+    bool instancing = true;
+    InstanceBuffer fragments;
+    
+    // Fragments outside the view are dropped before they are drawn. The
+    // visible ones are copied to their own instance buffer, which is only
+    // rebuilt when the set of visible fragments changes.
+    bool culling = true;
+    Frustum frustum;
+    Frustum::Spheres fragmentBounds;
+    vector<unsigned char> fragmentVisible, fragmentWasVisible;
+    vector<size_t> visibleSlot;
+    InstanceBuffer visibleFragments;
+    size_t fragmentsVisible = 0;
+    size_t fragmentsCulled = 0;
+    
+    // Targets and their fragments as a transform hierarchy. The targets are
+    // nodes 0 to n-1 and fragment f of target i is node n + 8*i + f, so only
+    // the fragments that are flying apart get new matrices every frame.
+    SceneGraph targetScene;
+    vector<unsigned char> fragmentMoving;
+    size_t transformsUpdated = 0;
+    
 
     //ground plane info
     GLuint GrndBuffObj, GrndNorBuffObj, GrndTexBuffObj, GIndxBuffObj;
@@ -156,7 +280,7 @@ public:
     unsigned int createSky(string dir, vector<string> faces) {
         unsigned int textureID;
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        GLState::bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
         
         int width, height, nrChannels;
         stbi_set_flip_vertically_on_load(false);
@@ -206,26 +330,37 @@ public:
         // Enable z-buffer test.
         glEnable(GL_DEPTH_TEST);
         
-        // Initialize the GLSL program.
+        // The uniform blocks; the materials never change
+        frameBlock.init(GLSL::FrameBlockBinding, sizeof(FrameConstants));
+        materialBlock.init(GLSL::MaterialBlockBinding, sizeof(MaterialConstants));
+        materialBlock.update(&materials, sizeof(MaterialConstants));
+        
+        // Initialize the GLSL programs. They only start compiling here, see
+        // finishPrograms().
         prog = make_shared<Program>();
         prog->setVerbose(true);
         prog->setShaderNames(
                              resourceDirectory + "/simple_vert.glsl",
                              resourceDirectory + "/simple_frag.glsl");
-        if (! prog->init())
-        {
-            std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
-            exit(1);
-        }
-        prog->addUniform("P");
-        prog->addUniform("MV");
-        prog->addUniform("MatAmb");
-        prog->addUniform("MatDif");
-        prog->addUniform("view");
+        prog->submit();
+        progMV = prog->addUniform("MV");
+        progMaterial = prog->addUniform("material");
         prog->addAttribute("vertPos");
         prog->addAttribute("vertNor");
         prog->addAttribute("vertTex");
         
+        // Same shading as prog, with the model matrix and material per instance
+        instProg = make_shared<Program>();
+        instProg->setVerbose(true);
+        instProg->setShaderNames(
+                                 resourceDirectory + "/inst_vert.glsl",
+                                 resourceDirectory + "/inst_frag.glsl");
+        instProg->submit();
+        instProg->addAttribute("vertPos");
+        instProg->addAttribute("vertNor");
+        instProg->addAttribute("instModel");
+        instProg->addAttribute("instMaterial");
+        
         //create two frame buffer objects to toggle between
         glGenFramebuffers(2, frameBuf);
         glGenTextures(2, texBuf);
@@ -252,16 +387,12 @@ public:
         texProg->setShaderNames(
                                 resourceDirectory + "/pass_vert.glsl",
                                 resourceDirectory + "/tex_fragH.glsl");
-        if (! texProg->init())
-        {
-            std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
-            exit(1);
-        }
-        texProg->addUniform("texBuf");
+        texProg->submit();
+        texTexBuf = texProg->addUniform("texBuf");
         texProg->addAttribute("vertPos");
         texProg->addAttribute("vertTex");
         texProg->addAttribute("vertNor");
-        texProg->addUniform("dir");
+        texDir = texProg->addUniform("dir");
         
         initTex(resourceDirectory);
         
@@ -270,15 +401,9 @@ public:
         cubeProg->setShaderNames(
                                  resourceDirectory + "/cube_vert.glsl",
                                  resourceDirectory + "/cube_frag.glsl");
-        if (! cubeProg->init())
-        {
-            std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
-            exit(1);
-        }
-        cubeProg->addUniform("P");
-        cubeProg->addUniform("M");
-        cubeProg->addUniform("V");
-        cubeProg->addUniform("view");
+        cubeProg->submit();
+        cubeM = cubeProg->addUniform("M");
+        cubeV = cubeProg->addUniform("V");
         cubeProg->addAttribute("vertPos");
     }
     
@@ -289,28 +414,23 @@ public:
         
         string errStr;
         // Initialize the obj mesh VBOs etc
-        shape = make_shared<Shape>();
-        shape->loadMesh(resourceDirectory + "/sphere.obj");
-        shape->resize();
-        shape->init();
+        meshes.setReleaseCPUBuffers(true);
+        meshes.setVertexFormat(vertexFormat);
+        meshes.setMeshletSplit(true);
+        meshes.setOptimize(optimizeMeshes, optimizeOverdraw);
+        shape = meshes.get(resourceDirectory + "/sphere.obj");
         //Initialize the geometry to render a quad to the screen
         initQuad();
         
         // Initialize the obj mesh VBOs etc
-        target = make_shared<Shape>();
-        target->loadMesh(resourceDirectory + "/cube.obj");
-        target->resize();
-        target->init();
+        target = meshes.get(resourceDirectory + "/cube.obj");
         //Initialize the geometry to render a quad to the screen
         initQuad();
         
         
-        cube =  make_shared<Shape>();
-        cube->loadMesh(resourceDirectory + "/cube.obj");
-        cube->resize();
-        cube->init();
-        
+        cube = meshes.get(resourceDirectory + "/cube.obj");
         
+        meshes.printStats();
     }
     
     /**** geometry set up for a quad *****/
@@ -318,7 +438,7 @@ public:
     {
         //now set up a simple quad for rendering FBO
         glGenVertexArrays(1, &quad_VertexArrayID);
-        glBindVertexArray(quad_VertexArrayID);
+        GLState::bindVertexArray(quad_VertexArrayID);
         
         static const GLfloat g_quad_vertex_buffer_data[] =
         {
@@ -331,13 +451,11 @@ public:
         };
         
         glGenBuffers(1, &quad_vertexbuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
         glBufferData(GL_ARRAY_BUFFER, sizeof(g_quad_vertex_buffer_data), g_quad_vertex_buffer_data, GL_STATIC_DRAW);
         
-        for (int i = 0; i<20; i++) {
-            positions[i] = glm::vec3(rand() % 20 - 10, rand() % 20 - 10, rand() % 20 - 10);
-            
-        }
+        sim.reset(targetCount, 1);
+        buildTargetScene();
         
         float g_groundSize = 20;
         float g_groundY = -1.5;
@@ -371,23 +489,23 @@ public:
         GLuint VertexArrayID;
         //generate the VAO
         glGenVertexArrays(1, &VertexArrayID);
-        glBindVertexArray(VertexArrayID);
+        GLState::bindVertexArray(VertexArrayID);
         
         gGiboLen = 6;
         glGenBuffers(1, &GrndBuffObj);
-        glBindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
         glBufferData(GL_ARRAY_BUFFER, sizeof(GrndPos), GrndPos, GL_STATIC_DRAW);
         
         glGenBuffers(1, &GrndNorBuffObj);
-        glBindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
         glBufferData(GL_ARRAY_BUFFER, sizeof(GrndNorm), GrndNorm, GL_STATIC_DRAW);
         
         glGenBuffers(1, &GrndTexBuffObj);
-        glBindBuffer(GL_ARRAY_BUFFER, GrndTexBuffObj);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, GrndTexBuffObj);
         glBufferData(GL_ARRAY_BUFFER, sizeof(GrndTex), GrndTex, GL_STATIC_DRAW);
         
         glGenBuffers(1, &GIndxBuffObj);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
     }
     
@@ -402,7 +520,7 @@ public:
         //set up framebuffer
         glBindFramebuffer(GL_FRAMEBUFFER, fb);
         //set up texture
-        glBindTexture(GL_TEXTURE_2D, tex);
+        GLState::bindTexture(GL_TEXTURE_2D, tex);
         
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -424,45 +542,279 @@ public:
     // with the prior scene image - next lab we will process
     void ProcessImage(GLuint inTex)
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, inTex);
+        GLState::activeTexture(GL_TEXTURE0);
+        GLState::bindTexture(GL_TEXTURE_2D, inTex);
         
         // example applying of 'drawing' the FBO texture - change shaders
         texProg->bind();
-        glUniform1i(texProg->getUniform("texBuf"), 0);
-        glUniform2f(texProg->getUniform("dir"), -1, 0);
+        glUniform1i(texProg->getUniform(texTexBuf), 0);
+        glUniform2f(texProg->getUniform(texDir), -1, 0);
+        // Shape VAOs keep their attribute setup, the quad gets its own
+        GLState::bindVertexArray(quad_VertexArrayID);
         glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glDisableVertexAttribArray(0);
         texProg->unbind();
     }
     
-    vec3 calculateTrajectory(vec3 initialVelocity, float gravityInY, float time){
-        vec3 outDisplacement;
+    // Waits for the programs submitted in init(), which the driver can link
+    // while initGeom() loads the meshes
+    void finishPrograms()
+    {
+        for (const std::shared_ptr<Program> &p : {prog, instProg, texProg, cubeProg})
+        {
+            if (! p->finish())
+            {
+                std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
+                exit(1);
+            }
+            if (hotReload)
+            {
+                shaderFiles.add(p->getVertexShaderName());
+                shaderFiles.add(p->getFragmentShaderName());
+            }
+        }
+    }
+    
+    // Starts recompiling the programs whose shaders changed on disk, and
+    // swaps in the ones that are done linking
+    void reloadShaders()
+    {
+        if (! hotReload)
+        {
+            return;
+        }
+        const std::initializer_list<std::shared_ptr<Program>> programs = {prog, instProg, texProg, cubeProg};
+        for (const std::string &file : shaderFiles.poll())
+        {
+            for (const std::shared_ptr<Program> &p : programs)
+            {
+                if (p->usesShader(file))
+                {
+                    p->reload();
+                }
+            }
+        }
+        for (const std::shared_ptr<Program> &p : programs)
+        {
+            p->updateReload();
+        }
+    }
+    
+    // Startup cost of the shader programs, each compiled or from the cache
+    void printProgramTimes() const
+    {
+        double seconds = 0;
+        int hits = 0;
+        for (const std::shared_ptr<Program> &p : {prog, instProg, texProg, cubeProg})
+        {
+            seconds += p->getInitSeconds();
+            hits += p->isFromCache() ? 1 : 0;
+        }
+        cout << "Shader programs ready in " << seconds * 1000.0 << " ms, "
+            << hits << " of 4 from the program cache" << endl;
+    }
+    
+    // Per lookup cost of finding prog's uniforms by name and by id
+    void benchUniformLookups()
+    {
+        const int lookups = 5000000;
+        const char *names[2] = {"MV", "material"};
+        const Program::UniformID ids[2] = {progMV, progMaterial};
+        
+        // Summing the locations keeps the loops from being optimized away
+        long checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++)
+        {
+            checksum += prog->getUniform(names[i % 2]);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++)
+        {
+            checksum += prog->getUniform(ids[i % 2]);
+        }
+        auto end = std::chrono::steady_clock::now();
         
-        outDisplacement.x = initialVelocity.x * time;
-        outDisplacement.z = initialVelocity.z * time;
+        cout << "Uniform lookup by name: "
+            << std::chrono::duration<double, std::nano>(middle - start).count() / lookups << " ns, by id: "
+            << std::chrono::duration<double, std::nano>(end - middle).count() / lookups << " ns"
+            << " (checksum " << checksum << ")" << endl;
+    }
+    
+    // Finds the fragments that are in view and brings visibleFragments up to
+    // date: rebuilt if the visible set changed, otherwise only the fragments
+    // that moved are copied. Returns the instances to draw.
+    InstanceBuffer &cullFragments()
+    {
+        if (! culling)
+        {
+            fragmentsVisible = fragments.size();
+            fragmentsCulled = 0;
+            return fragments;
+        }
         
-        float timeSquared = time * time;
-        outDisplacement.y = (initialVelocity.y * time) + 0.5*(gravityInY * timeSquared);
-        return outDisplacement;
+        fragmentsVisible = frustum.cull(fragmentBounds, fragmentVisible);
+        fragmentsCulled = fragments.size() - fragmentsVisible;
+        if (fragmentVisible != fragmentWasVisible)
+        {
+            visibleFragments.clear();
+            visibleSlot.resize(fragments.size());
+            for (size_t k = 0; k < fragments.size(); k++)
+            {
+                if (fragmentVisible[k])
+                {
+                    visibleSlot[k] = visibleFragments.size();
+                    visibleFragments.add(fragments[k].model, fragments[k].material);
+                }
+            }
+            fragmentWasVisible = fragmentVisible;
+            return visibleFragments;
+        }
+        
+        const size_t targets = sim.positions.size();
+        for (SceneGraph::Node node : targetScene.getUpdated())
+        {
+            const size_t k = node - targets;
+            if (node >= (SceneGraph::Node) targets && fragmentVisible[k])
+            {
+                visibleFragments.setModel(visibleSlot[k], fragments[k].model);
+            }
+        }
+        return visibleFragments;
     }
     
+    // Where fragment f sits in its target while the target is whole
+    static mat4 fragmentRest(int f)
+    {
+        return scale(translate(mat4(1.0f), targetFragments[f].offset), vec3(0.05, 0.05, 0.05));
+    }
     
-    bool checkCollision(vec3 ball, vec3 cube){
-        float dx = ball.x - cube.x;
-        float dy = ball.y - cube.y;
-        float dz = ball.z - cube.z;
-        float distance = sqrt(dx*dx + dy*dy + dz*dz);
+    void buildTargetScene()
+    {
+        targetScene.clear();
+        for (size_t i = 0; i < sim.positions.size(); i++)
+        {
+            targetScene.add(SceneGraph::NoParent, translate(mat4(1.0f), sim.positions[i]/10.0f));
+        }
+        for (size_t i = 0; i < sim.positions.size(); i++)
+        {
+            for (int f = 0; f < 8; f++)
+            {
+                targetScene.add((SceneGraph::Node) i, fragmentRest(f));
+            }
+        }
+        fragmentMoving.assign(sim.positions.size() * 8, 0);
         
-        if(distance <= 1.3f){
-            return true;
+        // Every node is updated once, which fills these in
+        fragments.clear();
+        fragmentBounds.clear();
+        for (size_t k = 0; k < sim.positions.size() * 8; k++)
+        {
+            fragments.add(mat4(1.0f), (int) (k / 8 % 4));
+            fragmentBounds.add(vec3(0.0f), 0.0f);
         }
-        return false;
     }
-    int cur;
+    
+    void buildFragments(const shared_ptr<MatrixStack> &MV)
+    {
+        const size_t targets = sim.positions.size();
+        const Simulation::Ball &ball = sim.balls[0];
+        MV->pushMatrix();
+        for (size_t i = 0; i < targets; i++)
+        {
+            if (sim.hit[i] != 1)
+            {
+                // Back in one piece after a reset
+                for (int f = 0; f < 8; f++)
+                {
+                    const size_t k = i * 8 + f;
+                    if (fragmentMoving[k])
+                    {
+                        targetScene.setLocal((SceneGraph::Node) (targets + k), fragmentRest(f));
+                        fragmentMoving[k] = 0;
+                    }
+                }
+                continue;
+            }
+            
+            const float boom = sim.explosionAt(i, simAlpha);
+            for (int f = 0; f < 8; f++)
+            {
+                const TargetFragment &frag = targetFragments[f];
+                const size_t k = i * 8 + f;
+                
+                vec3 velocity = ball.direction + sim.positions[i] * frag.spread;
+                vec3 yeet = Simulation::calculateTrajectory(velocity * ball.explode, -.003, boom);
+                MV->loadIdentity();
+                MV->translate(frag.offset);
+                MV->scale(vec3(0.05, 0.05, 0.05));
+                MV->translate(yeet);
+                MV->rotate(frag.spin[0] * boom/20, frag.axis[0]);
+                MV->rotate(frag.spin[1] * boom/20, frag.axis[1]);
+                targetScene.setLocal((SceneGraph::Node) (targets + k), MV->topMatrix());
+                fragmentMoving[k] = 1;
+            }
+        }
+        MV->popMatrix();
+        transformsUpdated = targetScene.update();
+        
+        // Only the fragments whose world matrix changed get new instance
+        // data and a new bounding sphere
+        for (SceneGraph::Node node : targetScene.getUpdated())
+        {
+            if (node < (SceneGraph::Node) targets)
+            {
+                continue;
+            }
+            const mat4 &M = targetScene.getWorld(node);
+            fragments.setModel(node - targets, M);
+            // cube.obj is resized to [-1, 1], so the sphere around it has a
+            // radius of sqrt(3) before the model matrix scales it
+            float scale = std::max(length(vec3(M[0])), std::max(length(vec3(M[1])), length(vec3(M[2]))));
+            fragmentBounds.set(node - targets, vec3(M[3]), 1.7320508f * scale);
+        }
+    }
+    
+    // Runs the steps that are due at the given glfwGetTime(). After a stall
+    // the steps that did not fit are dropped, so the game slows down instead
+    // of spending every later frame catching up.
+    void simulate(double now)
+    {
+        // Up to 8 ticks of game time per frame, whatever the step rate
+        const double dt = 1.0 / simRate;
+        const int maxSteps = std::max((int) std::ceil(8.0 * simRate / Simulation::TickRate), 1);
+        
+        Simulation::Ball &ball = sim.balls[0];
+        ball.charging = mouseDown;
+        ball.aim = vec3(x, y, z);
+        
+        if (simClock < 0.0)
+        {
+            simClock = now;
+        }
+        simAccumulator += now - simClock;
+        simClock = now;
+        
+        int steps = 0;
+        while (simAccumulator >= dt && steps < maxSteps)
+        {
+            sim.step(dt);
+            simAccumulator -= dt;
+            steps++;
+        }
+        if (ball.landed)
+        {
+            ball.landed = false;
+            thrown = false;
+            Moving = false;
+        }
+        simAccumulator = std::min(simAccumulator, dt);
+        simAlpha = (float) (simAccumulator / dt);
+    }
+    
     void render()
     {
         // Get current frame buffer size.
@@ -494,17 +846,26 @@ public:
         vec3 center = vec3(x, y, z);
         vec3 up = vec3(0, 1, 0);
         
-        // Create the matrix stacks
-        auto P = make_shared<MatrixStack>();
-        auto MV = make_shared<MatrixStack>();
+        // Start the matrix stacks over
+        P->reset();
+        MV->reset();
         
         // Apply perspective projection.
         P->pushMatrix();
         P->perspective(45.0f, aspect, 0.01f, 100.0f);
         
+        // Camera data for every shader, uploaded once per frame
+        FrameConstants frame;
+        frame.P = P->topMatrix();
+        frame.view = lookAt(eye, center, up);
+        frame.eyePos = vec4(eye, 1.0f);
+        frameBlock.update(&frame, sizeof(frame));
+        frustum.extract(frame.P * frame.view);
+        
+        P->popMatrix();
+        
         //Draw our scene - two meshes - right now to a texture
         prog->bind();
-        glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
         
         // globl transforms for 'camera' (you will fix this now!)
         MV->pushMatrix();
@@ -518,23 +879,17 @@ public:
             MV->translate(vec3(2, -1, 0));
            
             SetMaterial(3);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
+            glUniformMatrix4fv(prog->getUniform(progMV), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
             if(!thrown){
-                shape->draw(prog);
+                shape->draw();
             }
             MV->popMatrix();
         MV->popMatrix();
         
-        P->popMatrix();
-        
         prog->unbind();
         
         
-        P->pushMatrix();
-        P->perspective(45.0f, aspect, 0.01f, 100.0f);
         prog->bind();
-        glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
         
         // globl transforms for 'camera' (you will fix this now!)
         MV->pushMatrix();
@@ -544,192 +899,40 @@ public:
                 MV->scale(vec3(0.01, 0.01, 0.01));
                 MV->translate(vec3(0, 0, 0));
                 MV->translate(vec3(0, 0, 0));
-                vec3 yeet = calculateTrajectory(vec3(xs,ys,zs) * shoot, -.0018, time);
-                ballPos = yeet/10.0f;
+                vec3 yeet = sim.flightAt(sim.balls[0], simAlpha);
                 MV->translate(yeet);
                 SetMaterial(3);
-                glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-                glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-                shape->draw(prog);
+                glUniformMatrix4fv(prog->getUniform(progMV), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
+                shape->draw();
             MV->popMatrix();
         MV->popMatrix();
         
-        P->popMatrix();
-        
         prog->unbind();
         
         
-        
-        P->pushMatrix();
-        P->perspective(45.0f, aspect, 0.01f, 100.0f);
-        prog->bind();
-        glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-        
-        // globl transforms for 'camera' (you will fix this now!)
-        MV->pushMatrix();
-        MV->loadIdentity();
-        //draw 20 cubes made of 8 different cubes
-        for (int i = 0; i < 20; i++)
+        //draw the targets, each made of 8 cube fragments
+        buildFragments(MV);
+        InstanceBuffer &drawn = cullFragments();
+        if (instancing)
         {
-            MV->pushMatrix();
-            MV->translate((positions[i]/10.0f));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i] + vec3(.5,.5,.5)) || hit[i] == 1){
-                hit[i] = 1;
-                cur = i;
-                vec3 yeet = calculateTrajectory(vec3(xs, ys, zs) * explode, -.003, explosion[i]);
-                explosion[i] += 0.5;
-                MV->translate(yeet);
-                MV->rotate(explosion[i]/20, vec3(0, 1, 0));
-                MV->rotate(explosion[i]/20, vec3(0, 0, 1));
-            }
-            
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0.1, 0, 0));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs+positions[i].x/5.0f,ys,zs) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(-explosion[i]/20, vec3(1, 0, 0));
-                MV->rotate(explosion[i]/20, vec3(0, 0, 1));
-            }
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-            
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0, 0.1, 0));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs,ys+positions[i].y/5.0f,zs) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(explosion[i]/20, vec3(0, 1, 0));
-                MV->rotate(-explosion[i]/20, vec3(1, 0, 0));
-            }
-            
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-            
-            
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0, 0, 0.1));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs,ys,zs+positions[i].z/5.0f) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(-explosion[i]/20, vec3(1, 0, 0));
-                MV->rotate(-explosion[i]/20, vec3(0, 1, 0));
-            }
-            
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-            
-            
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0.1, 0, 0.1));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs+positions[i].x/5.0f,ys,zs+positions[i].z/5.0f) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(explosion[i]/20, vec3(0, 0, 1));
-                MV->rotate(-explosion[i]/20, vec3(0, 1, 0));
-            }
-            
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-            
-            
-            
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0.1, 0.1, 0.1));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs+positions[i].x/5.0f,ys+positions[i].y/10.0f,zs+positions[i].z/5.0f) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(explosion[i]/20, vec3(1, 0, 0));
-                MV->rotate(explosion[i]/20, vec3(0, 0, 1));
-            }
-            
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-            
-            
-            
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0, 0.1, 0.1));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs,ys+positions[i].y/5.0f,zs+positions[i].z/5.0f) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(-explosion[i]/20, vec3(0, 0, 1));
-                MV->rotate(-explosion[i]/20, vec3(1, 0, 0));
-            }
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
-            
-            
-            MV->pushMatrix();
-            MV->translate(positions[i]/10.0f);
-            MV->translate(vec3(0.1, 0.1, 0));
-            MV->scale(vec3(0.05, 0.05, 0.05));
-            if(checkCollision(ballPos, positions[i]) || hit[i] == 1){
-                yeet = calculateTrajectory(vec3(xs+positions[i].x/5.0f,ys+positions[i].y/5.0f,zs) * explode, -.003, explosion[i]);
-                MV->translate(yeet);
-                MV->rotate(-explosion[i]/20, vec3(0, 1, 0));
-                MV->rotate(explosion[i]/20, vec3(0, 0, 1));
+            instProg->bind();
+            drawn.upload();
+            target->drawInstanced(drawn);
+            instProg->unbind();
+        }
+        else
+        {
+            prog->bind();
+            for (size_t f = 0; f < drawn.size(); f++)
+            {
+                SetMaterial(drawn[f].material);
+                glUniformMatrix4fv(prog->getUniform(progMV), 1, GL_FALSE,value_ptr(drawn[f].model) );
+                target->draw();
             }
-            
-            
-            SetMaterial(i%4);
-            glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-            glUniformMatrix4fv(prog->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-            target->draw(prog);
-            MV->popMatrix();
+            prog->unbind();
         }
-        MV->popMatrix();
-        
-        
-        
-        prog->unbind();
         
         cubeProg->bind();
-        glUniformMatrix4fv(cubeProg->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
         mat4 ident(1.0);
         glDepthFunc(GL_LEQUAL);
         MV->pushMatrix();
@@ -737,40 +940,17 @@ public:
         MV->rotate(radians(theta), vec3(0, 1, 0));
         MV->translate(vec3(0, 0.0, 0));
         MV->scale(50.0);
-        glUniformMatrix4fv(cubeProg->getUniform("V"), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
-        glUniformMatrix4fv(cubeProg->getUniform("M"), 1, GL_FALSE,value_ptr(ident));
-        glUniformMatrix4fv(cubeProg->getUniform("view"), 1, GL_FALSE,value_ptr(lookAt(eye, center, up)));
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-        cube->draw(texProg);
+        glUniformMatrix4fv(cubeProg->getUniform(cubeV), 1, GL_FALSE,value_ptr(MV->topMatrix()) );
+        glUniformMatrix4fv(cubeProg->getUniform(cubeM), 1, GL_FALSE,value_ptr(ident));
+        GLState::bindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
+        cube->draw();
         glDepthFunc(GL_LESS);
         MV->popMatrix();
         cubeProg->unbind();
         
-        P->popMatrix();
-        
         
-        if (mouseDown){
-            speed += 0.001;
-            explode = speed/2.0f;
-            xs = x;
-            ys = y;
-            zs = z;
-        }
-        if (!mouseDown && speed > 0.0)
-        {
-            shoot = speed;
-            if(time > 500){
-                thrown = false;
-                Moving = false;
-                time=0;
-                shoot = 0;
-                speed = 0;
-                explode = 0;
-                hit[cur] = 0;
-                explosion[cur] = 0;
-            }else{
-                time++;
-            }
+        if (!mouseDown && sim.balls[0].speed > 0.0)
+        {
             for (int i = 0; i < 3; i ++)
             {
                 //set up framebuffer
@@ -792,40 +972,640 @@ public:
     // helper function to set materials for shading
     void SetMaterial(int i)
     {
-        switch (i)
+        glUniform1i(prog->getUniform(progMaterial), i);
+    }
+    
+};
+
+// Largest difference between two matrices, relative to the largest element
+// of the reference
+static float matrixError(const mat4 &m, const mat4 &reference)
+{
+    float error = 0;
+    float magnitude = 1e-30f;
+    for (int c = 0; c < 4; c++)
+    {
+        for (int r = 0; r < 4; r++)
         {
-            case 0: //shiny blue plastic
-                glUniform3f(prog->getUniform("MatAmb"), 0.02f, 0.04f, 0.2f);
-                glUniform3f(prog->getUniform("MatDif"), 0.0f, 0.16f, 0.9f);
-                break;
-            case 1: // flat grey
-                glUniform3f(prog->getUniform("MatAmb"), 0.13f, 0.13f, 0.14f);
-                glUniform3f(prog->getUniform("MatDif"), 0.3f, 0.3f, 0.4f);
-                break;
-            case 2: //brass
-                glUniform3f(prog->getUniform("MatAmb"), 0.3294f, 0.2235f, 0.02745f);
-                glUniform3f(prog->getUniform("MatDif"), 0.7804f, 0.5686f, 0.11373f);
-                break;
-            case 3: //copper
-                glUniform3f(prog->getUniform("MatAmb"), 0.1913f, 0.0735f, 0.0225f);
-                glUniform3f(prog->getUniform("MatDif"), 0.7038f, 0.27048f, 0.0828f);
-                break;
+            error = std::max(error, std::abs(m[c][r] - reference[c][r]));
+            magnitude = std::max(magnitude, std::abs(reference[c][r]));
         }
     }
+    return error / magnitude;
+}
+
+// Benchmarks MatrixStack and checks its in place transforms against building
+// each transform with glm and multiplying by it, which is what MatrixStack
+// used to do. Returns false if they differ by more than a few float ulps.
+static bool benchMatrixStack()
+{
+    const int frames = 100;
+    const int cycles = 10000;
     
-};
+    // Summing the results keeps the loops from being optimized away
+    float checksum = 0;
+    
+    // push/translate/scale/pop on a freshly allocated std::stack of glm
+    // matrices, as every frame used to do, and on MatrixStack
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++)
+    {
+        auto reference = make_shared<std::stack<mat4>>();
+        reference->push(mat4(1.0f));
+        for (int i = 0; i < cycles; i++)
+        {
+            reference->push(reference->top());
+            reference->top() *= glm::translate(mat4(1.0f), vec3(i * 0.001f, 0, 0));
+            reference->top() *= glm::scale(mat4(1.0f), vec3(0.05f));
+            checksum += reference->top()[3][0];
+            reference->pop();
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    MatrixStack stack;
+    for (int f = 0; f < frames; f++)
+    {
+        stack.reset();
+        for (int i = 0; i < cycles; i++)
+        {
+            stack.pushMatrix();
+            stack.translate(vec3(i * 0.001f, 0, 0));
+            stack.scale(vec3(0.05f));
+            checksum += stack.topMatrix()[3][0];
+            stack.popMatrix();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    
+    const double count = (double) frames * cycles;
+    cout << "Matrix stack cycle with std::stack: "
+        << std::chrono::duration<double, std::nano>(middle - start).count() / count << " ns, MatrixStack: "
+        << std::chrono::duration<double, std::nano>(end - middle).count() / count << " ns" << endl;
+    
+    // The transforms of every fragment of an exploding target, with the same
+    // calls as buildFragments() makes on MV and with glm products
+    const int targets = 1250;
+    const vec3 direction = normalize(vec3(0.3f, 0.5f, -1.0f));
+    const float explode = 0.02f;
+    float maxError = 0;
+    double productSeconds = 0;
+    double stackSeconds = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        const float boom = f * 0.5f;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < targets; i++)
+        {
+            const vec3 position = vec3(i % 50 - 25, i % 7, -(i / 50));
+            for (const TargetFragment &frag : targetFragments)
+            {
+                vec3 velocity = direction + position * frag.spread;
+                vec3 yeet = Simulation::calculateTrajectory(velocity * explode, -.003, boom);
+                mat4 top(1.0f);
+                top *= glm::translate(mat4(1.0f), frag.offset);
+                top *= glm::scale(mat4(1.0f), vec3(0.05, 0.05, 0.05));
+                top *= glm::translate(mat4(1.0f), yeet);
+                top *= glm::rotate(mat4(1.0f), frag.spin[0] * boom/20, frag.axis[0]);
+                top *= glm::rotate(mat4(1.0f), frag.spin[1] * boom/20, frag.axis[1]);
+                checksum += top[3][0];
+            }
+        }
+        middle = std::chrono::steady_clock::now();
+        stack.reset();
+        stack.pushMatrix();
+        for (int i = 0; i < targets; i++)
+        {
+            const vec3 position = vec3(i % 50 - 25, i % 7, -(i / 50));
+            for (const TargetFragment &frag : targetFragments)
+            {
+                vec3 velocity = direction + position * frag.spread;
+                vec3 yeet = Simulation::calculateTrajectory(velocity * explode, -.003, boom);
+                stack.loadIdentity();
+                stack.translate(frag.offset);
+                stack.scale(vec3(0.05, 0.05, 0.05));
+                stack.translate(yeet);
+                stack.rotate(frag.spin[0] * boom/20, frag.axis[0]);
+                stack.rotate(frag.spin[1] * boom/20, frag.axis[1]);
+                checksum += stack.topMatrix()[3][0];
+            }
+        }
+        stack.popMatrix();
+        end = std::chrono::steady_clock::now();
+        productSeconds += std::chrono::duration<double>(middle - start).count();
+        stackSeconds += std::chrono::duration<double>(end - middle).count();
+    }
+    
+    // The same transforms compared matrix by matrix, and a mix of the other
+    // in place transforms on top of a parent translation
+    for (int f = 0; f < frames; f++)
+    {
+        const float explosion = f * 0.5f;
+        for (int i = 0; i < targets; i += 7)
+        {
+            const vec3 position = vec3(i % 50 - 25, i % 7, -(i / 50));
+            for (const TargetFragment &frag : targetFragments)
+            {
+                vec3 velocity = direction + position * frag.spread;
+                vec3 yeet = Simulation::calculateTrajectory(velocity * explode, -.003, explosion);
+                mat4 top(1.0f);
+                top *= glm::translate(mat4(1.0f), frag.offset);
+                top *= glm::scale(mat4(1.0f), vec3(0.05, 0.05, 0.05));
+                top *= glm::translate(mat4(1.0f), yeet);
+                top *= glm::rotate(mat4(1.0f), frag.spin[0] * explosion/20, frag.axis[0]);
+                top *= glm::rotate(mat4(1.0f), frag.spin[1] * explosion/20, frag.axis[1]);
+                stack.pushMatrix();
+                stack.loadIdentity();
+                stack.translate(frag.offset);
+                stack.scale(vec3(0.05, 0.05, 0.05));
+                stack.translate(yeet);
+                stack.rotate(frag.spin[0] * explosion/20, frag.axis[0]);
+                stack.rotate(frag.spin[1] * explosion/20, frag.axis[1]);
+                maxError = std::max(maxError, matrixError(stack.topMatrix(), top));
+                stack.popMatrix();
+                
+                top = mat4(1.0f);
+                stack.pushMatrix();
+                top *= glm::translate(mat4(1.0f), position / 10.0f);
+                stack.translate(position / 10.0f);
+                top *= glm::scale(mat4(1.0f), vec3(0.05f * (f + 1)));
+                stack.scale(0.05f * (f + 1));
+                top *= glm::rotate(mat4(1.0f), frag.spin[0] * explosion / 20, frag.axis[0] + frag.axis[1]);
+                stack.rotate(frag.spin[0] * explosion / 20, frag.axis[0] + frag.axis[1]);
+                top *= glm::scale(mat4(1.0f), frag.spread + vec3(0.5f));
+                stack.scale(frag.spread + vec3(0.5f));
+                top *= glm::translate(mat4(1.0f), position * frag.spread * explosion);
+                stack.translate(position * frag.spread * explosion);
+                maxError = std::max(maxError, matrixError(stack.topMatrix(), top));
+                stack.popMatrix();
+            }
+        }
+    }
+    
+    const double fragments = (double) frames * targets * 8;
+    const bool ok = maxError <= 8 * std::numeric_limits<float>::epsilon();
+    cout << "Fragment transforms with glm products: " << productSeconds * 1e9 / fragments
+        << " ns, MatrixStack: " << stackSeconds * 1e9 / fragments << " ns per fragment" << endl;
+    cout << "MatrixStack vs glm products: largest relative difference " << maxError
+        << (ok ? " (ok)" : " (too large)") << " (checksum " << checksum << ")" << endl;
+    return ok;
+}
+
+// Checks the half float conversion, then packs every mesh in resourceDir in
+// both packed formats and compares the decoded vertices to the float ones
+static bool checkVertexPacking(const std::string &resourceDir)
+{
+    bool ok = VertexPacking::checkHalfConversion();
+    for (const std::string &meshName : MeshLibrary::listMeshes(resourceDir))
+    {
+        Shape shape;
+        shape.loadMesh(meshName);
+        shape.resize();
+        const std::string label = meshName.substr(meshName.find_last_of("/\\") + 1);
+        ok &= shape.checkPacked(Shape::VertexFormat::Packed, label);
+        ok &= shape.checkPacked(Shape::VertexFormat::PackedHalf, label);
+    }
+    cout << "Vertex packing " << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+}
+
+// Parses every float in the meshes in resourceDir, and a million fuzzed
+// numbers, with the .obj parser and with strtod(), and compares the bits
+static bool checkFloatParser(const std::string &resourceDir)
+{
+    size_t checked = 0;
+    size_t mismatches = 0;
+    auto check = [&](const char *text, size_t len)
+    {
+        const std::string number(text, len);
+        double parsed = 0.0;
+        const bool ok = tinyobj::ParseDouble(number.c_str(), number.c_str() + len, &parsed);
+        const double expected = strtod(number.c_str(), NULL);
+        checked++;
+        if (! ok || memcmp(&parsed, &expected, sizeof(double)) != 0)
+        {
+            if (mismatches++ < 10)
+            {
+                cout.precision(17);
+                cout << "\"" << number << "\" parses to " << parsed << ", strtod() gives "
+                    << expected << endl;
+            }
+        }
+    };
+    
+    // The numbers of every v, vn and vt line
+    size_t fromMeshes = 0;
+    for (const std::string &meshName : MeshLibrary::listMeshes(resourceDir))
+    {
+        ifstream file(meshName);
+        std::string line;
+        while (getline(file, line))
+        {
+            if (line.compare(0, 2, "v ") != 0 && line.compare(0, 3, "vn ") != 0 &&
+                line.compare(0, 3, "vt ") != 0)
+            {
+                continue;
+            }
+            size_t pos = line.find(' ');
+            while ((pos = line.find_first_not_of(" \t\r", pos)) != std::string::npos)
+            {
+                const size_t end = std::min(line.find_first_of(" \t\r", pos), line.size());
+                check(line.data() + pos, end - pos);
+                fromMeshes++;
+                pos = end;
+            }
+        }
+    }
+    
+    // Random digit strings with up to 25 digits on each side of the point
+    // and exponents up to 999, which also covers the strtod() fallback, and
+    // %g and %f round trips of random doubles and floats
+    std::mt19937_64 random(1);
+    char buf[128];
+    const int fuzzed = 1000000;
+    for (int i = 0; i < fuzzed; i++)
+    {
+        int len = 0;
+        switch (i % 4)
+        {
+        case 0:
+        {
+            if (random() % 2)
+            {
+                buf[len++] = random() % 2 ? '-' : '+';
+            }
+            for (int d = 1 + random() % 25; d > 0; d--)
+            {
+                buf[len++] = '0' + random() % 10;
+            }
+            if (random() % 2)
+            {
+                buf[len++] = '.';
+                for (int d = random() % 25; d > 0; d--)
+                {
+                    buf[len++] = '0' + random() % 10;
+                }
+            }
+            if (random() % 2)
+            {
+                len += snprintf(buf + len, sizeof(buf) - len, "%c%d", random() % 2 ? 'e' : 'E',
+                    (int) (random() % 1999) - 999);
+            }
+            break;
+        }
+        case 1:
+        {
+            const uint64_t bits = random();
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            if (! std::isfinite(value))
+            {
+                value = 0.0;
+            }
+            len = snprintf(buf, sizeof(buf), "%.17g", value);
+            break;
+        }
+        case 2:
+        {
+            const uint32_t bits = (uint32_t) random();
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            if (! std::isfinite(value))
+            {
+                value = 0.0f;
+            }
+            len = snprintf(buf, sizeof(buf), "%.9g", value);
+            break;
+        }
+        default:
+        {
+            const double value = (double) (random() % 2000000001) / 1e7 - 100.0;
+            len = snprintf(buf, sizeof(buf), "%.*f", (int) (1 + random() % 8), value);
+            break;
+        }
+        }
+        check(buf, len);
+    }
+    
+    cout << "Float parser: " << fromMeshes << " numbers from the meshes and " << fuzzed
+        << " fuzzed, " << mismatches << " differ from strtod()" << endl;
+    return mismatches == 0;
+}
+
+// Prints the simulated vertex cache behavior of every mesh in resourceDir
+// before and after optimize(), without and with the overdraw pass
+static void printVertexCacheStats(const std::string &resourceDir)
+{
+    cout << "FIFO cache of " << MeshOptimizer::CacheSize
+        << " vertices, ACMR 0.5 and ATVR 1.0 are optimal" << endl;
+    for (const std::string &meshName : MeshLibrary::listMeshes(resourceDir))
+    {
+        const std::string label = meshName.substr(meshName.find_last_of("/\\") + 1);
+        for (bool overdraw : {false, true})
+        {
+            Shape shape;
+            shape.loadMesh(meshName);
+            shape.optimize(overdraw);
+            shape.printCacheStats(overdraw ? label + " with overdraw pass" : label);
+        }
+    }
+}
+
+// True if two loads of the same .obj produced exactly the same shapes
+static bool sameShapes(const std::vector<tinyobj::shape_t> &a, const std::vector<tinyobj::shape_t> &b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        const tinyobj::mesh_t &m = a[i].mesh;
+        const tinyobj::mesh_t &n = b[i].mesh;
+        if (a[i].name != b[i].name || m.positions != n.positions || m.normals != n.normals ||
+            m.texcoords != n.texcoords || m.indices != n.indices || m.material_ids != n.material_ids)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Times loading every mesh in resourceDir through std::ifstream, the way
+// LoadObj() reads a file, and through LoadObjMapped(), and checks that both
+// give the same shapes
+static bool benchLoad(const std::string &resourceDir)
+{
+    const int loads = 20;
+    
+    cout << "Mean of " << loads << " loads after one warm-up load" << endl;
+    cout.setf(std::ios::fixed);
+    cout.precision(3);
+    bool ok = true;
+    double streamTotal = 0.0;
+    double mappedTotal = 0.0;
+    for (const std::string &meshName : MeshLibrary::listMeshes(resourceDir))
+    {
+        std::vector<tinyobj::shape_t> streamShapes, mappedShapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        // The warm-up loads are the ones compared
+        tinyobj::LoadObj(streamShapes, materials, err, meshName.c_str());
+        tinyobj::LoadObjMapped(mappedShapes, materials, err, meshName.c_str());
+        const bool same = sameShapes(streamShapes, mappedShapes);
+        ok &= same;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < loads; i++)
+        {
+            streamShapes.clear();
+            materials.clear();
+            tinyobj::LoadObj(streamShapes, materials, err, meshName.c_str());
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int i = 0; i < loads; i++)
+        {
+            mappedShapes.clear();
+            materials.clear();
+            tinyobj::LoadObjMapped(mappedShapes, materials, err, meshName.c_str());
+        }
+        auto end = std::chrono::steady_clock::now();
+        
+        const double streamSeconds = std::chrono::duration<double>(middle - start).count() / loads;
+        const double mappedSeconds = std::chrono::duration<double>(end - middle).count() / loads;
+        streamTotal += streamSeconds;
+        mappedTotal += mappedSeconds;
+        cout << meshName.substr(meshName.find_last_of("/\\") + 1) << ": istream " << streamSeconds * 1e3
+            << " ms, mapped " << mappedSeconds * 1e3 << " ms (" << streamSeconds / mappedSeconds << "x)"
+            << (same ? "" : " DIFFERS") << endl;
+    }
+    cout << "All meshes: istream " << streamTotal * 1e3 << " ms, mapped " << mappedTotal * 1e3 << " ms"
+        << (ok ? "" : ", loads DIFFER") << endl;
+    return ok;
+}
+
+// Times the buffer parse of LoadObj() on 1, 2, 4, 8 and 16 threads and
+// checks each result against the single-threaded one. Every mesh in
+// resourceDir is repeated to 8 MiB first: the loader does not split below
+// 256 KiB per thread, so the meshes themselves would all parse serially.
+static bool benchParallelLoad(const std::string &resourceDir)
+{
+    const size_t minSize = 8 << 20;
+    const int threadCounts[] = {1, 2, 4, 8, 16};
+    const int runs = 3;
+    
+    cout << "Parallel .obj parse, best of " << runs << " runs, "
+        << std::thread::hardware_concurrency() << " hardware threads" << endl;
+    cout.setf(std::ios::fixed);
+    cout.precision(2);
+    bool ok = true;
+    for (const std::string &meshName : MeshLibrary::listMeshes(resourceDir))
+    {
+        ifstream file(meshName, std::ios::binary);
+        std::string mesh((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (mesh.empty())
+        {
+            continue;
+        }
+        if (mesh.back() != '\n')
+        {
+            mesh += '\n';
+        }
+        // Face indices are absolute, so the copies all index the vertices of
+        // the first one, which is still a valid .obj
+        std::string buffer;
+        while (buffer.size() < minSize)
+        {
+            buffer += mesh;
+        }
+        
+        tinyobj::MaterialFileReader materialReader(resourceDir + "/");
+        std::vector<tinyobj::shape_t> serial;
+        double serialSeconds = 0.0;
+        const std::string label = meshName.substr(meshName.find_last_of("/\\") + 1);
+        cout << label << " x" << buffer.size() / mesh.size() << " (" << buffer.size() / 1048576.0
+            << " MiB):";
+        for (int threads : threadCounts)
+        {
+            double best = std::numeric_limits<double>::max();
+            bool same = true;
+            for (int run = 0; run < runs; run++)
+            {
+                std::vector<tinyobj::shape_t> shapes;
+                std::vector<tinyobj::material_t> materials;
+                std::string err;
+                auto start = std::chrono::steady_clock::now();
+                tinyobj::LoadObj(shapes, materials, err, buffer.data(), buffer.size(), materialReader,
+                    threads);
+                auto end = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double>(end - start).count());
+                if (threads == 1 && run == 0)
+                {
+                    serial.swap(shapes);
+                }
+                else
+                {
+                    same &= sameShapes(shapes, serial);
+                }
+            }
+            if (threads == 1)
+            {
+                serialSeconds = best;
+            }
+            cout << (threads == 1 ? " " : ", ") << threads << (threads == 1 ? " thread " : " threads ")
+                << best * 1e3 << " ms";
+            if (threads > 1)
+            {
+                cout << " (" << serialSeconds / best << "x)";
+            }
+            if (! same)
+            {
+                cout << " DIFFERS";
+                ok = false;
+            }
+            cout.flush();
+        }
+        cout << endl;
+    }
+    cout << "Parallel parse " << (ok ? "matches the serial parse" : "FAILED") << endl;
+    return ok;
+}
 
 int main(int argc, char **argv)
 {
     // Where the resources are loaded from
     std::string resourceDir = "../resources";
     
-    if (argc >= 2)
+    Application *application = new Application();
+    // Frames to time before exiting, 0 runs until the window is closed
+    int benchFrames = 0;
+    bool countGLCalls = false;
+    bool benchUniforms = false;
+    bool checkPacking = false;
+    bool checkParser = false;
+    bool benchParallel = false;
+    bool benchLoading = false;
+    bool cacheStats = false;
+    // Frames per monitor refresh: 1 is vsync, 0 renders as fast as possible
+    int swapInterval = 1;
+    
+    // Options start with "--", anything else is the resource directory
+    for (int i = 1; i < argc; i++)
     {
-        resourceDir = argv[1];
+        std::string arg = argv[i];
+        if (arg == "--packed")
+        {
+            application->vertexFormat = Shape::VertexFormat::Packed;
+        }
+        else if (arg == "--packed-half")
+        {
+            application->vertexFormat = Shape::VertexFormat::PackedHalf;
+        }
+        else if (arg == "--optimize")
+        {
+            application->optimizeMeshes = true;
+        }
+        else if (arg == "--optimize-overdraw")
+        {
+            application->optimizeMeshes = true;
+            application->optimizeOverdraw = true;
+        }
+        else if (arg == "--no-instancing")
+        {
+            application->instancing = false;
+        }
+        else if (arg == "--no-culling")
+        {
+            application->culling = false;
+        }
+        else if (arg == "--targets" && i + 1 < argc)
+        {
+            application->targetCount = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--sim-rate" && i + 1 < argc)
+        {
+            application->simRate = std::max(atof(argv[++i]), 1.0);
+        }
+        else if (arg == "--swap-interval" && i + 1 < argc)
+        {
+            swapInterval = std::max(atoi(argv[++i]), 0);
+        }
+        else if (arg == "--bench" && i + 1 < argc)
+        {
+            benchFrames = std::max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--bench-matrix-stack")
+        {
+            // Needs no window
+            return benchMatrixStack() ? 0 : 1;
+        }
+        else if (arg == "--check-vertex-packing")
+        {
+            checkPacking = true;
+        }
+        else if (arg == "--check-float-parser")
+        {
+            checkParser = true;
+        }
+        else if (arg == "--cache-stats")
+        {
+            cacheStats = true;
+        }
+        else if (arg == "--bench-load")
+        {
+            benchLoading = true;
+        }
+        else if (arg == "--bench-parallel-load")
+        {
+            benchParallel = true;
+        }
+        else if (arg == "--bench-uniforms")
+        {
+            benchUniforms = true;
+        }
+        else if (arg == "--no-hot-reload")
+        {
+            application->hotReload = false;
+        }
+        else if (arg == "--no-shader-cache")
+        {
+            ProgramCache::setEnabled(false);
+        }
+        else if (arg == "--count-gl-calls")
+        {
+            countGLCalls = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Unknown option " << arg << endl;
+        }
+        else
+        {
+            resourceDir = arg;
+        }
     }
     
-    Application *application = new Application();
+    // Checks that need no window, only the resource directory
+    if (checkPacking)
+    {
+        return checkVertexPacking(resourceDir) ? 0 : 1;
+    }
+    if (checkParser)
+    {
+        return checkFloatParser(resourceDir) ? 0 : 1;
+    }
+    if (cacheStats)
+    {
+        printVertexCacheStats(resourceDir);
+        return 0;
+    }
+    if (benchLoading)
+    {
+        return benchLoad(resourceDir) ? 0 : 1;
+    }
+    if (benchParallel)
+    {
+        return benchParallelLoad(resourceDir) ? 0 : 1;
+    }
     
     // Your main will always include a similar set up to establish your window
     // and GL context, etc.
@@ -835,17 +1615,87 @@ int main(int argc, char **argv)
     windowManager->setEventCallbacks(application);
     application->windowManager = windowManager;
     
+    if (countGLCalls)
+    {
+        GLCallCounter::install();
+    }
+    
     // This is the code that will likely change program to program as you
     // may need to initialize or set up different data and state
     
     application->init(resourceDir);
+    if (benchUniforms)
+    {
+        application->finishPrograms();
+        application->benchUniformLookups();
+        windowManager->shutdown();
+        return 0;
+    }
     application->initGeom(resourceDir);
+    application->finishPrograms();
+    application->printProgramTimes();
+    
+    if (benchFrames > 0)
+    {
+        // Do not let vsync hold the benchmark back
+        swapInterval = 0;
+    }
+    glfwSwapInterval(swapInterval);
+    
+    int frames = 0;
+    double renderSeconds = 0;
+    size_t glCalls = 0;
+    GLState::Stats binds;
+    size_t visible = 0;
+    size_t culled = 0;
+    size_t transforms = 0;
     
     // Loop until the user closes the window.
     while (! glfwWindowShouldClose(windowManager->getHandle()))
     {
         // Render scene.
+        GLCallCounter::reset();
+        GLState::resetStats();
+        GLSL::beginFrame();
+        application->reloadShaders();
+        application->simulate(glfwGetTime());
+        auto start = std::chrono::steady_clock::now();
         application->render();
+        renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        glCalls += GLCallCounter::count();
+        binds.issued += GLState::getStats().issued;
+        binds.elided += GLState::getStats().elided;
+        visible += application->fragmentsVisible;
+        culled += application->fragmentsCulled;
+        transforms += application->transformsUpdated;
+        frames++;
+        
+        if (countGLCalls && benchFrames == 0 && frames % 100 == 1)
+        {
+            cout << "GL calls this frame: " << GLCallCounter::count() << ", binds issued "
+                << GLState::getStats().issued << ", elided " << GLState::getStats().elided
+                << ", fragments visible " << application->fragmentsVisible << ", culled "
+                << application->fragmentsCulled << ", transforms updated "
+                << application->transformsUpdated << endl;
+        }
+        if (benchFrames > 0 && frames == benchFrames)
+        {
+            cout << "Rendered " << frames << " frames of " << application->targetCount << " targets ("
+                << (application->instancing ? "instanced" : "one draw per fragment") << "): "
+                << renderSeconds * 1000.0 / frames << " ms CPU per frame";
+            if (countGLCalls)
+            {
+                cout << ", " << glCalls / frames << " GL calls per frame";
+            }
+            cout << ", binds issued " << binds.issued / frames << ", elided "
+                << binds.elided / frames << " per frame" << endl;
+            cout << "Fragments visible " << visible / frames << ", culled "
+                << culled / frames << ", transforms updated " << transforms / frames
+                << " per frame" << endl;
+            cout << "Simulation steps " << application->sim.ticks << " at "
+                << application->simRate << " Hz" << endl;
+            break;
+        }
         
         // Swap front and back buffers.
         glfwSwapBuffers(windowManager->getHandle());
@@ -5,12 +5,29 @@
 #include <cmath>
 #include <cstddef>
 #include <cctype>
+#include <cstdio>
 
 #include <string>
 #include <vector>
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "tiny_obj_loader.h"
 
@@ -27,17 +44,111 @@ struct vertex_index {
   vertex_index(int vidx, int vtidx, int vnidx)
       : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx){}
 };
-// for std::map
-static inline bool operator<(const vertex_index &a, const vertex_index &b) {
-  if (a.v_idx != b.v_idx)
-    return (a.v_idx < b.v_idx);
-  if (a.vn_idx != b.vn_idx)
-    return (a.vn_idx < b.vn_idx);
-  if (a.vt_idx != b.vt_idx)
-    return (a.vt_idx < b.vt_idx);
+// Open-addressing hash table used to deduplicate (v, vt, vn) triples while
+// faces are flattened. Replaces a std::map<vertex_index, unsigned int>: no
+// allocation per entry and O(1) lookups. Linear probing over a power of two
+// number of slots, kept at most half full.
+class vertex_index_cache {
+public:
+  vertex_index_cache() : count_(0), mask_(0) {}
+
+  // Makes room for `n` entries without rehashing.
+  void reserve(size_t n) {
+    size_t capacity = 16;
+    while (capacity < 2 * n) {
+      capacity *= 2;
+    }
+    if (capacity > slots_.size()) {
+      rehash(capacity);
+    }
+  }
 
-  return false;
-}
+  void clear() {
+    slots_.clear();
+    count_ = 0;
+    mask_ = 0;
+  }
+
+  // Returns the value stored for `key`. If there is none, `value` is stored
+  // and returned, and `inserted` is set to true.
+  unsigned int findOrInsert(const vertex_index &key, unsigned int value,
+                            bool &inserted) {
+    if (2 * (count_ + 1) > slots_.size()) {
+      rehash(slots_.empty() ? 16 : 2 * slots_.size());
+    }
+
+    size_t slot = hash(key) & mask_;
+    for (;;) {
+      entry &e = slots_[slot];
+      if (e.value == kEmpty) {
+        e.v_idx = key.v_idx;
+        e.vt_idx = key.vt_idx;
+        e.vn_idx = key.vn_idx;
+        e.value = value;
+        count_++;
+        inserted = true;
+        return value;
+      }
+      if (e.v_idx == key.v_idx && e.vt_idx == key.vt_idx &&
+          e.vn_idx == key.vn_idx) {
+        inserted = false;
+        return e.value;
+      }
+      slot = (slot + 1) & mask_;
+    }
+  }
+
+private:
+  struct entry {
+    int v_idx, vt_idx, vn_idx;
+    unsigned int value; // kEmpty marks a free slot
+  };
+
+  static const unsigned int kEmpty = 0xffffffffu;
+
+  static size_t hash(const vertex_index &key) {
+    // Pack the triple into 64 bits and mix (splitmix64 finalizer).
+    unsigned long long h =
+        static_cast<unsigned long long>(static_cast<unsigned int>(key.v_idx));
+    h ^= static_cast<unsigned long long>(static_cast<unsigned int>(key.vt_idx))
+         << 21;
+    h ^= static_cast<unsigned long long>(static_cast<unsigned int>(key.vn_idx))
+         << 42;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return static_cast<size_t>(h);
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<entry> old;
+    old.swap(slots_);
+
+    entry empty;
+    empty.v_idx = empty.vt_idx = empty.vn_idx = 0;
+    empty.value = kEmpty;
+    slots_.assign(capacity, empty);
+    mask_ = capacity - 1;
+
+    for (size_t i = 0; i < old.size(); i++) {
+      if (old[i].value == kEmpty) {
+        continue;
+      }
+      size_t slot = hash(vertex_index(old[i].v_idx, old[i].vt_idx,
+                                      old[i].vn_idx)) & mask_;
+      while (slots_[slot].value != kEmpty) {
+        slot = (slot + 1) & mask_;
+      }
+      slots_[slot] = old[i];
+    }
+  }
+
+  std::vector<entry> slots_;
+  size_t count_;
+  size_t mask_;
+};
 
 struct obj_shape {
   std::vector<float> v;
@@ -61,7 +172,7 @@ static inline int fixIndex(int idx, int n) {
 static inline std::string parseString(const char *&token) {
   std::string s;
   token += strspn(token, " \t");
-  size_t e = strcspn(token, " \t\r");
+  size_t e = strcspn(token, " \t\r\n");
   s = std::string(token, &token[e]);
   token += e;
   return s;
@@ -70,11 +181,69 @@ static inline std::string parseString(const char *&token) {
 static inline int parseInt(const char *&token) {
   token += strspn(token, " \t");
   int i = atoi(token);
-  token += strcspn(token, " \t\r");
+  token += strcspn(token, " \t\r\n");
   return i;
 }
 
 
+// Powers of ten that are exactly representable as a double.
+static const double kExactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// strtod() on a number already accepted by tryParseDouble(). The decimal
+// point is dropped and folded into the exponent ("-1.25e3" becomes
+// "-125e1"), so the result does not depend on LC_NUMERIC and no locale is
+// queried; this runs on the LoadObjParallel() worker threads.
+static void parseDoubleSlow(const char *s, const char *s_end, double *result)
+{
+    std::string str;
+    str.reserve(static_cast<size_t>(s_end - s) + 16);
+
+    const char *curr = s;
+    if (curr != s_end && (*curr == '+' || *curr == '-'))
+        str += *curr++;
+
+    int exponent = 0;
+    while (curr != s_end && isdigit(*curr))
+        str += *curr++;
+    if (curr != s_end && *curr == '.')
+    {
+        curr++;
+        while (curr != s_end && isdigit(*curr))
+        {
+            str += *curr++;
+            exponent--;
+        }
+    }
+
+    if (curr != s_end && (*curr == 'e' || *curr == 'E'))
+    {
+        curr++;
+        bool exp_negative = false;
+        if (curr != s_end && (*curr == '+' || *curr == '-'))
+        {
+            exp_negative = (*curr == '-');
+            curr++;
+        }
+        int exp_value = 0;
+        while (curr != s_end && isdigit(*curr))
+        {
+            // Same cap as tryParseDouble(); beyond it the value is 0 or inf.
+            if (exp_value < 100000)
+                exp_value = exp_value * 10 + (*curr - '0');
+            curr++;
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    char exp_buf[16];
+    snprintf(exp_buf, sizeof(exp_buf), "e%d", exponent);
+    str += exp_buf;
+
+    *result = strtod(str.c_str(), NULL);
+}
+
 // Tries to parse a floating point number located at s.
 //
 // s_end should be a location in the string where reading should absolutely
@@ -101,6 +270,13 @@ static inline int parseInt(const char *&token) {
 // The following situations triggers a failure:
 //  - s >= s_end.
 //  - parse failure.
+//
+// The result is correctly rounded. The significant digits are collected into
+// a 64 bit integer; when that integer and the power of ten are both exactly
+// representable as a double (Clinger's fast path), one multiplication or
+// division gives the correctly rounded value. That covers practically every
+// number found in .obj files. Anything else (more than 19 significant
+// digits, huge or tiny exponents) falls back to parseDoubleSlow().
 // 
 static bool tryParseDouble(const char *s, const char *s_end, double *result)
 {
@@ -109,26 +285,22 @@ static bool tryParseDouble(const char *s, const char *s_end, double *result)
         return false;
     }
 
-    double mantissa = 0.0;
-    // This exponent is base 2 rather than 10.
-    // However the exponent we parse is supposed to be one of ten,
-    // thus we must take care to convert the exponent/and or the 
-    // mantissa to a * 2^E, where a is the mantissa and E is the
-    // exponent.
-    // To get the final double we will use ldexp, it requires the
-    // exponent to be in base 2.
+    // Up to 19 significant decimal digits always fit into 64 bits.
+    const int kMaxDigits = 19;
+
+    unsigned long long mantissa = 0;
+    // Number of digits accumulated in mantissa (leading zeros excluded).
+    int digits = 0;
+    // Set when a non-zero digit did not fit into mantissa.
+    bool truncated = false;
+    // Decimal exponent to apply to mantissa.
     int exponent = 0;
 
-    // NOTE: THESE MUST BE DECLARED HERE SINCE WE ARE NOT ALLOWED
-    // TO JUMP OVER DEFINITIONS.
-    char sign = '+';
-    char exp_sign = '+';
+    bool negative = false;
     char const *curr = s;
 
     // How many characters were read in a loop. 
     int read = 0;
-    // Tells whether a loop terminated due to reaching s_end.
-    bool end_not_reached = false;
 
     /*
         BEGIN PARSING.
@@ -137,93 +309,128 @@ static bool tryParseDouble(const char *s, const char *s_end, double *result)
     // Find out what sign we've got.
     if (*curr == '+' || *curr == '-')
     {
-        sign = *curr;
+        negative = (*curr == '-');
         curr++;
     }
     else if (isdigit(*curr)) { /* Pass through. */ }
     else
     {
-        goto fail;
+        return false;
     }
 
     // Read the integer part.
-    while ((end_not_reached = (curr != s_end)) && isdigit(*curr))
+    while (curr != s_end && isdigit(*curr))
     {
-        mantissa *= 10;
-        mantissa += static_cast<int>(*curr - 0x30);
+        int digit = *curr - '0';
+        if (digits < kMaxDigits)
+        {
+            mantissa = mantissa * 10 + static_cast<unsigned int>(digit);
+            digits += (mantissa != 0);
+        }
+        else
+        {
+            exponent++;
+            truncated |= (digit != 0);
+        }
         curr++; read++;
     }
 
     // We must make sure we actually got something.
     if (read == 0)
-        goto fail;
-    // We allow numbers of form "#", "###" etc.
-    if (!end_not_reached)
-        goto assemble;
+        return false;
 
     // Read the decimal part.
-    if (*curr == '.')
+    if (curr != s_end && *curr == '.')
     {
         curr++;
-        read = 1;
-        while ((end_not_reached = (curr != s_end)) && isdigit(*curr))
+        while (curr != s_end && isdigit(*curr))
         {
-            // NOTE: Don't use powf here, it will absolutely murder precision.
-            mantissa += static_cast<int>(*curr - 0x30) * pow(10.0, -read);
-            read++; curr++;
+            int digit = *curr - '0';
+            if (digits < kMaxDigits)
+            {
+                mantissa = mantissa * 10 + static_cast<unsigned int>(digit);
+                digits += (mantissa != 0);
+                exponent--;
+            }
+            else
+            {
+                truncated |= (digit != 0);
+            }
+            curr++;
         }
     }
-    else if (*curr == 'e' || *curr == 'E') {}
-    else
-    {
-        goto assemble;
-    }
-
-    if (!end_not_reached)
-        goto assemble;
 
     // Read the exponent part.
-    if (*curr == 'e' || *curr == 'E')
+    if (curr != s_end && (*curr == 'e' || *curr == 'E'))
     {
         curr++;
+        bool exp_negative = false;
         // Figure out if a sign is present and if it is.
-        if ((end_not_reached = (curr != s_end)) && (*curr == '+' || *curr == '-'))
+        if (curr != s_end && (*curr == '+' || *curr == '-'))
         {
-            exp_sign = *curr;
+            exp_negative = (*curr == '-');
             curr++;
         }
-        else if (isdigit(*curr)) { /* Pass through. */ }
-        else
-        {
-            // Empty E is not allowed.
-            goto fail;
-        }
 
+        int exp_value = 0;
         read = 0;
-        while ((end_not_reached = (curr != s_end)) && isdigit(*curr))
+        while (curr != s_end && isdigit(*curr))
         {
-            exponent *= 10;
-            exponent += static_cast<int>(*curr - 0x30);
+            // Anything beyond this over- or underflows anyway.
+            if (exp_value < 100000)
+            {
+                exp_value = exp_value * 10 + (*curr - '0');
+            }
             curr++; read++;
         }
-        exponent *= (exp_sign == '+'? 1 : -1);
+        // Empty E is not allowed.
         if (read == 0)
-            goto fail;
+            return false;
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    /*
+        ASSEMBLE.
+    */
+
+    if (mantissa == 0)
+    {
+        *result = negative ? -0.0 : 0.0;
+        return true;
     }
 
-assemble:
-    *result = (sign == '+'? 1 : -1) * ldexp(mantissa * pow(5.0, exponent), exponent);
+    if (!truncated && mantissa <= (1ULL << 53))
+    {
+        // A mantissa with room to spare can absorb part of a large exponent.
+        while (exponent > 22 && mantissa * 10 <= (1ULL << 53))
+        {
+            mantissa *= 10;
+            exponent--;
+        }
+
+        if (exponent >= -22 && exponent <= 22)
+        {
+            double value = static_cast<double>(mantissa);
+            if (exponent < 0)
+                value /= kExactPowersOfTen[-exponent];
+            else
+                value *= kExactPowersOfTen[exponent];
+            *result = negative ? -value : value;
+            return true;
+        }
+    }
+
+    parseDoubleSlow(s, curr, result);
     return true;
-fail:
-    return false;
 }
+
 static inline float parseFloat(const char *&token) {
   token += strspn(token, " \t");
 #ifdef TINY_OBJ_LOADER_OLD_FLOAT_PARSER
   float f = (float)atof(token);
-  token += strcspn(token, " \t\r");
+  token += strcspn(token, " \t\r\n");
 #else
-  const char *end = token + strcspn(token, " \t\r");
+  const char *end = token + strcspn(token, " \t\r\n");
   double val = 0.0;
   tryParseDouble(token, end, &val);
   float f = static_cast<float>(val);
@@ -246,13 +453,20 @@ static inline void parseFloat3(float &x, float &y, float &z,
 }
 
 // Parse triples: i, i/j/k, i//k, i/j
+// If `relative` is given, it receives a mask of the components that were
+// given as relative (negative) indices: 1 = v, 2 = vt, 4 = vn.
 static vertex_index parseTriple(const char *&token, int vsize, int vnsize,
-                                int vtsize) {
+                                int vtsize, unsigned char *relative = NULL) {
   vertex_index vi(-1);
+  unsigned char rel = 0;
+  int idx;
 
-  vi.v_idx = fixIndex(atoi(token), vsize);
-  token += strcspn(token, "/ \t\r");
+  idx = atoi(token);
+  rel |= (idx < 0) ? 1 : 0;
+  vi.v_idx = fixIndex(idx, vsize);
+  token += strcspn(token, "/ \t\r\n");
   if (token[0] != '/') {
+    if (relative) *relative = rel;
     return vi;
   }
   token++;
@@ -260,37 +474,48 @@ static vertex_index parseTriple(const char *&token, int vsize, int vnsize,
   // i//k
   if (token[0] == '/') {
     token++;
-    vi.vn_idx = fixIndex(atoi(token), vnsize);
-    token += strcspn(token, "/ \t\r");
+    idx = atoi(token);
+    rel |= (idx < 0) ? 4 : 0;
+    vi.vn_idx = fixIndex(idx, vnsize);
+    token += strcspn(token, "/ \t\r\n");
+    if (relative) *relative = rel;
     return vi;
   }
 
   // i/j/k or i/j
-  vi.vt_idx = fixIndex(atoi(token), vtsize);
-  token += strcspn(token, "/ \t\r");
+  idx = atoi(token);
+  rel |= (idx < 0) ? 2 : 0;
+  vi.vt_idx = fixIndex(idx, vtsize);
+  token += strcspn(token, "/ \t\r\n");
   if (token[0] != '/') {
+    if (relative) *relative = rel;
     return vi;
   }
 
   // i/j/k
   token++; // skip '/'
-  vi.vn_idx = fixIndex(atoi(token), vnsize);
-  token += strcspn(token, "/ \t\r");
+  idx = atoi(token);
+  rel |= (idx < 0) ? 4 : 0;
+  vi.vn_idx = fixIndex(idx, vnsize);
+  token += strcspn(token, "/ \t\r\n");
+  if (relative) *relative = rel;
   return vi;
 }
 
 static unsigned int
-updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
+updateVertex(vertex_index_cache &vertexCache,
              std::vector<float> &positions, std::vector<float> &normals,
              std::vector<float> &texcoords,
              const std::vector<float> &in_positions,
              const std::vector<float> &in_normals,
              const std::vector<float> &in_texcoords, const vertex_index &i) {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
+  bool inserted = false;
+  unsigned int idx = vertexCache.findOrInsert(
+      i, static_cast<unsigned int>(positions.size() / 3), inserted);
 
-  if (it != vertexCache.end()) {
+  if (!inserted) {
     // found cache
-    return it->second;
+    return idx;
   }
 
   assert(in_positions.size() > static_cast<unsigned int>(3 * i.v_idx + 2));
@@ -310,9 +535,6 @@ updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
     texcoords.push_back(in_texcoords[2 * static_cast<size_t>(i.vt_idx) + 1]);
   }
 
-  unsigned int idx = static_cast<unsigned int>(positions.size() / 3 - 1);
-  vertexCache[i] = idx;
-
   return idx;
 }
 
@@ -339,27 +561,50 @@ static void InitMaterial(material_t &material) {
   material.unknown_parameter.clear();
 }
 
+// Faces of the current group. They are kept flattened so that parsing a face
+// line does not allocate a std::vector of its own.
+struct face_group {
+  std::vector<vertex_index> vertices;
+  std::vector<unsigned int> sizes; // number of vertices in each face
+
+  bool empty() const { return sizes.empty(); }
+  void clear() {
+    vertices.clear();
+    sizes.clear();
+  }
+};
+
 static bool exportFaceGroupToShape(
-    shape_t &shape, std::map<vertex_index, unsigned int> vertexCache,
+    shape_t &shape, vertex_index_cache &vertexCache,
     const std::vector<float> &in_positions,
     const std::vector<float> &in_normals,
     const std::vector<float> &in_texcoords,
-    const std::vector<std::vector<vertex_index> > &faceGroup,
+    const face_group &faceGroup,
     const int material_id, const std::string &name, bool clearCache) {
   if (faceGroup.empty()) {
     return false;
   }
 
+  // A closed mesh has roughly half as many vertices as triangles, so sizing
+  // the cache from the face count avoids rehashing for typical input
+  // without paying for the every-corner-is-unique worst case up front.
+  vertexCache.reserve(faceGroup.sizes.size());
+
   // Flatten vertices and indices
-  for (size_t i = 0; i < faceGroup.size(); i++) {
-    const std::vector<vertex_index> &face = faceGroup[i];
+  size_t offset = 0;
+  for (size_t i = 0; i < faceGroup.sizes.size(); i++) {
+    const vertex_index *face = &faceGroup.vertices[offset];
+    size_t npolys = faceGroup.sizes[i];
+    offset += npolys;
+
+    if (npolys < 3) {
+      continue;
+    }
 
     vertex_index i0 = face[0];
     vertex_index i1(-1);
     vertex_index i2 = face[1];
 
-    size_t npolys = face.size();
-
     // Polygon -> triangle fan conversion
     for (size_t k = 2; k < npolys; k++) {
       i1 = i2;
@@ -642,6 +887,485 @@ bool MaterialFileReader::operator()(const std::string &matId,
   return true;
 }
 
+// Copies the next whitespace delimited word into namebuf. This is what
+// sscanf(token, "%s", namebuf) did, but it never looks past the end of the
+// current line, which matters when the line lives inside a mapped file.
+static inline void parseName(char *namebuf, size_t bufsize,
+                             const char *&token) {
+  token += strspn(token, " \t");
+  size_t len = strcspn(token, " \t\r\n");
+  if (len >= bufsize) {
+    len = bufsize - 1;
+  }
+  memcpy(namebuf, token, len);
+  namebuf[len] = '\0';
+  token += len;
+}
+
+// One slice of a buffer parsed by the parallel loader. Vertex attributes are
+// parsed completely. Faces and every other non-trivial line (usemtl, mtllib,
+// g, o, ...) are recorded in file order, so obj_line_parser can replay them
+// serially and produce exactly what a single-threaded parse would.
+struct obj_chunk {
+  struct event {
+    const char *line;    // line to re-parse, or NULL for a face
+    unsigned int nverts; // number of corners of the face
+  };
+
+  std::vector<float> v;
+  std::vector<float> vn;
+  std::vector<float> vt;
+  std::vector<vertex_index> corners;
+  std::vector<unsigned char> relative; // per corner, see parseTriple()
+  std::vector<event> events;
+  std::string lastLine; // copy of an unterminated final line
+
+  void parse(const char *begin, const char *end);
+  void parseLine(const char *line);
+};
+
+void obj_chunk::parse(const char *begin, const char *end) {
+  const char *line = begin;
+  while (line < end) {
+    const char *eol = static_cast<const char *>(
+        memchr(line, '\n', static_cast<size_t>(end - line)));
+
+    if (!eol) {
+      lastLine.assign(line, end);
+      parseLine(lastLine.c_str());
+      break;
+    }
+
+    parseLine(line);
+    line = eol + 1;
+  }
+}
+
+void obj_chunk::parseLine(const char *line) {
+  const char *token = line + strspn(line, " \t");
+
+  if (isNewLine(token[0]) || token[0] == '#') {
+    return;
+  }
+
+  // vertex
+  if (token[0] == 'v' && isSpace((token[1]))) {
+    token += 2;
+    float x, y, z;
+    parseFloat3(x, y, z, token);
+    v.push_back(x);
+    v.push_back(y);
+    v.push_back(z);
+    return;
+  }
+
+  // normal
+  if (token[0] == 'v' && token[1] == 'n' && isSpace((token[2]))) {
+    token += 3;
+    float x, y, z;
+    parseFloat3(x, y, z, token);
+    vn.push_back(x);
+    vn.push_back(y);
+    vn.push_back(z);
+    return;
+  }
+
+  // texcoord
+  if (token[0] == 'v' && token[1] == 't' && isSpace((token[2]))) {
+    token += 3;
+    float x, y;
+    parseFloat2(x, y, token);
+    vt.push_back(x);
+    vt.push_back(y);
+    return;
+  }
+
+  event e;
+
+  // face, with relative indices resolved against this chunk only
+  if (token[0] == 'f' && isSpace((token[1]))) {
+    token += 2;
+    token += strspn(token, " \t");
+
+    e.line = NULL;
+    e.nverts = 0;
+    while (!isNewLine(token[0])) {
+      unsigned char rel = 0;
+      vertex_index vi = parseTriple(token, static_cast<int>(v.size() / 3),
+                                    static_cast<int>(vn.size() / 3),
+                                    static_cast<int>(vt.size() / 2), &rel);
+      corners.push_back(vi);
+      relative.push_back(rel);
+      e.nverts++;
+      token += strspn(token, " \t\r");
+    }
+    events.push_back(e);
+    return;
+  }
+
+  e.line = token;
+  e.nverts = 0;
+  events.push_back(e);
+}
+
+// Parser state shared by the std::istream and the in-memory loaders.
+// parseLine() consumes a single line, which may either be a NUL terminated
+// copy (istream path) or point straight into the caller's buffer and end at
+// "\n" or "\r\n" (in-memory path); the token helpers above stop at both.
+class obj_line_parser {
+public:
+  obj_line_parser(std::vector<shape_t> &shapes,
+                  std::vector<material_t> &materials, std::string &err,
+                  MaterialReader &readMatFn)
+      : shapes_(shapes), materials_(materials), err_(err),
+        readMatFn_(readMatFn), material_(-1) {}
+
+  // Returns false if parsing has to stop (material file reader failed).
+  bool parseLine(const char *token);
+
+  // Appends the attributes of a chunk parsed by obj_chunk and replays its
+  // faces and lines. Chunks must be replayed in file order. Returns false
+  // if parsing has to stop.
+  bool replayChunk(const obj_chunk &chunk);
+
+  // Flushes the last face group.
+  void finish();
+
+private:
+  void flushFaceGroup();
+
+  std::vector<shape_t> &shapes_;
+  std::vector<material_t> &materials_;
+  std::string &err_;
+  MaterialReader &readMatFn_;
+
+  std::vector<float> v_;
+  std::vector<float> vn_;
+  std::vector<float> vt_;
+  face_group faceGroup_;
+  std::string name_;
+
+  // material
+  std::map<std::string, int> material_map_;
+  vertex_index_cache vertexCache_;
+  int material_;
+
+  shape_t shape_;
+};
+
+void obj_line_parser::flushFaceGroup() {
+  bool ret = exportFaceGroupToShape(shape_, vertexCache_, v_, vn_, vt_,
+                                    faceGroup_, material_, name_, true);
+  if (ret) {
+    shapes_.push_back(shape_);
+  }
+  shape_ = shape_t();
+  faceGroup_.clear();
+}
+
+bool obj_line_parser::parseLine(const char *token) {
+  // Skip leading space.
+  token += strspn(token, " \t");
+
+  assert(token);
+  if (isNewLine(token[0]))
+    return true; // empty line
+
+  if (token[0] == '#')
+    return true; // comment line
+
+  // vertex
+  if (token[0] == 'v' && isSpace((token[1]))) {
+    token += 2;
+    float x, y, z;
+    parseFloat3(x, y, z, token);
+    v_.push_back(x);
+    v_.push_back(y);
+    v_.push_back(z);
+    return true;
+  }
+
+  // normal
+  if (token[0] == 'v' && token[1] == 'n' && isSpace((token[2]))) {
+    token += 3;
+    float x, y, z;
+    parseFloat3(x, y, z, token);
+    vn_.push_back(x);
+    vn_.push_back(y);
+    vn_.push_back(z);
+    return true;
+  }
+
+  // texcoord
+  if (token[0] == 'v' && token[1] == 't' && isSpace((token[2]))) {
+    token += 3;
+    float x, y;
+    parseFloat2(x, y, token);
+    vt_.push_back(x);
+    vt_.push_back(y);
+    return true;
+  }
+
+  // face
+  if (token[0] == 'f' && isSpace((token[1]))) {
+    token += 2;
+    token += strspn(token, " \t");
+
+    unsigned int nverts = 0;
+    while (!isNewLine(token[0])) {
+      vertex_index vi = parseTriple(token, static_cast<int>(v_.size() / 3),
+                                    static_cast<int>(vn_.size() / 3),
+                                    static_cast<int>(vt_.size() / 2));
+      faceGroup_.vertices.push_back(vi);
+      nverts++;
+      size_t n = strspn(token, " \t\r");
+      token += n;
+    }
+
+    faceGroup_.sizes.push_back(nverts);
+
+    return true;
+  }
+
+  // use mtl
+  if ((0 == strncmp(token, "usemtl", 6)) && isSpace((token[6]))) {
+
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    token += 7;
+    parseName(namebuf, sizeof(namebuf), token);
+
+    // Create face group per material.
+    flushFaceGroup();
+
+    if (material_map_.find(namebuf) != material_map_.end()) {
+      material_ = material_map_[namebuf];
+    } else {
+      // { error!! material not found }
+      material_ = -1;
+    }
+
+    return true;
+  }
+
+  // load mtl
+  if ((0 == strncmp(token, "mtllib", 6)) && isSpace((token[6]))) {
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    token += 7;
+    parseName(namebuf, sizeof(namebuf), token);
+
+    std::string err_mtl;
+    bool ok = readMatFn_(namebuf, materials_, material_map_, err_mtl);
+    err_ += err_mtl;
+
+    if (!ok) {
+      faceGroup_.clear(); // for safety
+      return false;
+    }
+
+    return true;
+  }
+
+  // group name
+  if (token[0] == 'g' && isSpace((token[1]))) {
+
+    // flush previous face group.
+    // material = -1;
+    flushFaceGroup();
+
+    std::vector<std::string> names;
+    while (!isNewLine(token[0])) {
+      std::string str = parseString(token);
+      names.push_back(str);
+      token += strspn(token, " \t\r"); // skip tag
+    }
+
+    assert(names.size() > 0);
+
+    // names[0] must be 'g', so skip the 0th element.
+    if (names.size() > 1) {
+      name_ = names[1];
+    } else {
+      name_ = "";
+    }
+
+    return true;
+  }
+
+  // object name
+  if (token[0] == 'o' && isSpace((token[1]))) {
+
+    // flush previous face group.
+    // material = -1;
+    flushFaceGroup();
+
+    // @todo { multiple object name? }
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    token += 2;
+    parseName(namebuf, sizeof(namebuf), token);
+    name_ = std::string(namebuf);
+
+    return true;
+  }
+
+  // Ignore unknown command.
+  return true;
+}
+
+bool obj_line_parser::replayChunk(const obj_chunk &chunk) {
+  // Relative indices in the chunk were resolved against the chunk's own
+  // attributes; shift them by what precedes the chunk.
+  const int vOffset = static_cast<int>(v_.size() / 3);
+  const int vnOffset = static_cast<int>(vn_.size() / 3);
+  const int vtOffset = static_cast<int>(vt_.size() / 2);
+
+  v_.insert(v_.end(), chunk.v.begin(), chunk.v.end());
+  vn_.insert(vn_.end(), chunk.vn.begin(), chunk.vn.end());
+  vt_.insert(vt_.end(), chunk.vt.begin(), chunk.vt.end());
+
+  size_t corner = 0;
+  for (size_t i = 0; i < chunk.events.size(); i++) {
+    const obj_chunk::event &e = chunk.events[i];
+
+    if (e.line) {
+      if (!parseLine(e.line)) {
+        return false;
+      }
+      continue;
+    }
+
+    for (unsigned int k = 0; k < e.nverts; k++, corner++) {
+      vertex_index vi = chunk.corners[corner];
+      const unsigned char rel = chunk.relative[corner];
+      if (rel & 1) vi.v_idx += vOffset;
+      if (rel & 2) vi.vt_idx += vtOffset;
+      if (rel & 4) vi.vn_idx += vnOffset;
+      faceGroup_.vertices.push_back(vi);
+    }
+    faceGroup_.sizes.push_back(e.nverts);
+  }
+
+  return true;
+}
+
+void obj_line_parser::finish() {
+  bool ret = exportFaceGroupToShape(shape_, vertexCache_, v_, vn_, vt_,
+                                    faceGroup_, material_, name_, true);
+  if (ret) {
+    shapes_.push_back(shape_);
+  }
+  faceGroup_.clear(); // for safety
+}
+
+// Read-only view of a whole file. Uses mmap() (MapViewOfFile on Windows) so
+// the parser can tokenize the file contents without copying them first.
+class mapped_file {
+public:
+  mapped_file() : data_(NULL), size_(0) {}
+  ~mapped_file() { close(); }
+
+  bool open(const char *filename);
+  void close();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  mapped_file(const mapped_file &);
+  mapped_file &operator=(const mapped_file &);
+
+  const char *data_;
+  size_t size_;
+};
+
+#ifdef _WIN32
+bool mapped_file::open(const char *filename) {
+  close();
+
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    return false;
+  }
+  if (fileSize.QuadPart == 0) {
+    // Empty files can not be mapped, but they are valid (empty) input.
+    CloseHandle(file);
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping) {
+    return false;
+  }
+
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view) {
+    return false;
+  }
+
+  data_ = static_cast<const char *>(view);
+  size_ = static_cast<size_t>(fileSize.QuadPart);
+  return true;
+}
+
+void mapped_file::close() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  data_ = NULL;
+  size_ = 0;
+}
+#else
+bool mapped_file::open(const char *filename) {
+  close();
+
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    ::close(fd);
+    return false;
+  }
+  if (sb.st_size == 0) {
+    // Empty files can not be mapped, but they are valid (empty) input.
+    ::close(fd);
+    return true;
+  }
+
+  void *addr = mmap(NULL, static_cast<size_t>(sb.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+
+  // The whole file is consumed front to back exactly once.
+  madvise(addr, static_cast<size_t>(sb.st_size), MADV_SEQUENTIAL);
+
+  data_ = static_cast<const char *>(addr);
+  size_ = static_cast<size_t>(sb.st_size);
+  return true;
+}
+
+void mapped_file::close() {
+  if (data_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+}
+#endif
+
 bool LoadObj(std::vector<shape_t> &shapes, // [output]
              std::vector<material_t> &materials, // [output]
              std::string &err,
@@ -667,24 +1391,40 @@ bool LoadObj(std::vector<shape_t> &shapes, // [output]
   return LoadObj(shapes, materials, err, ifs, matFileReader);
 }
 
+bool LoadObjMapped(std::vector<shape_t> &shapes, // [output]
+                   std::vector<material_t> &materials, // [output]
+                   std::string &err,
+                   const char *filename, const char *mtl_basepath,
+                   int num_threads) {
+
+  shapes.clear();
+
+  std::stringstream errss;
+
+  mapped_file file;
+  if (!file.open(filename)) {
+    errss << "Cannot open file [" << filename << "]" << std::endl;
+    err = errss.str();
+    return false;
+  }
+
+  std::string basePath;
+  if (mtl_basepath) {
+    basePath = mtl_basepath;
+  }
+  MaterialFileReader matFileReader(basePath);
+
+  return LoadObj(shapes, materials, err, file.data(), file.size(),
+                 matFileReader, num_threads);
+}
+
 bool LoadObj(std::vector<shape_t> &shapes, // [output]
              std::vector<material_t> &materials, // [output]
              std::string& err,
              std::istream &inStream, MaterialReader &readMatFn) {
   std::stringstream errss;
 
-  std::vector<float> v;
-  std::vector<float> vn;
-  std::vector<float> vt;
-  std::vector<std::vector<vertex_index> > faceGroup;
-  std::string name;
-
-  // material
-  std::map<std::string, int> material_map;
-  std::map<vertex_index, unsigned int> vertexCache;
-  int material = -1;
-
-  shape_t shape;
+  obj_line_parser parser(shapes, materials, err, readMatFn);
 
   int maxchars = 8192;             // Alloc enough size.
   std::vector<char> buf(static_cast<size_t>(maxchars)); // Alloc enough size.
@@ -708,192 +1448,123 @@ bool LoadObj(std::vector<shape_t> &shapes, // [output]
       continue;
     }
 
-    // Skip leading space.
-    const char *token = linebuf.c_str();
-    token += strspn(token, " \t");
-
-    assert(token);
-    if (token[0] == '\0')
-      continue; // empty line
-
-    if (token[0] == '#')
-      continue; // comment line
-
-    // vertex
-    if (token[0] == 'v' && isSpace((token[1]))) {
-      token += 2;
-      float x, y, z;
-      parseFloat3(x, y, z, token);
-      v.push_back(x);
-      v.push_back(y);
-      v.push_back(z);
-      continue;
-    }
-
-    // normal
-    if (token[0] == 'v' && token[1] == 'n' && isSpace((token[2]))) {
-      token += 3;
-      float x, y, z;
-      parseFloat3(x, y, z, token);
-      vn.push_back(x);
-      vn.push_back(y);
-      vn.push_back(z);
-      continue;
-    }
-
-    // texcoord
-    if (token[0] == 'v' && token[1] == 't' && isSpace((token[2]))) {
-      token += 3;
-      float x, y;
-      parseFloat2(x, y, token);
-      vt.push_back(x);
-      vt.push_back(y);
-      continue;
+    if (!parser.parseLine(linebuf.c_str())) {
+      return false;
     }
+  }
 
-    // face
-    if (token[0] == 'f' && isSpace((token[1]))) {
-      token += 2;
-      token += strspn(token, " \t");
-
-      std::vector<vertex_index> face;
-      while (!isNewLine(token[0])) {
-        vertex_index vi =
-            parseTriple(token, static_cast<int>(v.size() / 3), static_cast<int>(vn.size() / 3), static_cast<int>(vt.size() / 2));
-        face.push_back(vi);
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
+  parser.finish();
 
-      faceGroup.push_back(face);
+  err += errss.str();
+  return true;
+}
 
-      continue;
-    }
+bool ParseDouble(const char *s, const char *s_end, double *result) {
+  return tryParseDouble(s, s_end, result);
+}
 
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6)) && isSpace((token[6]))) {
+// Smallest slice of a buffer worth handing to a thread of its own.
+static const size_t kMinChunkSize = 256 * 1024;
 
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 7;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
+static void parseChunks(std::vector<obj_chunk> *chunks,
+                        const std::vector<const char *> *bounds, size_t first,
+                        size_t step) {
+  for (size_t i = first; i < chunks->size(); i += step) {
+    (*chunks)[i].parse((*bounds)[i], (*bounds)[i + 1]);
+  }
+}
 
-      // Create face group per material.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt,
-                                        faceGroup, material, name, true);
-      if (ret) {
-          shapes.push_back(shape);
-      }
-      shape = shape_t();
-      faceGroup.clear();
-
-      if (material_map.find(namebuf) != material_map.end()) {
-        material = material_map[namebuf];
-      } else {
-        // { error!! material not found }
-        material = -1;
-      }
+static bool LoadObjParallel(obj_line_parser &parser, const char *buf,
+                            size_t len, unsigned int num_threads) {
+  size_t nchunks = num_threads;
+  if (nchunks > len / kMinChunkSize) {
+    nchunks = len / kMinChunkSize;
+  }
+  if (nchunks < 1) {
+    nchunks = 1;
+  }
 
-      continue;
+  // Split at line boundaries.
+  const char *end = buf + len;
+  std::vector<const char *> bounds;
+  bounds.push_back(buf);
+  for (size_t i = 1; i < nchunks; i++) {
+    const char *split = buf + len / nchunks * i;
+    if (split < bounds.back()) {
+      split = bounds.back();
     }
+    const char *eol = static_cast<const char *>(
+        memchr(split, '\n', static_cast<size_t>(end - split)));
+    bounds.push_back(eol ? eol + 1 : end);
+  }
+  bounds.push_back(end);
 
-    // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && isSpace((token[6]))) {
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 7;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
+  std::vector<obj_chunk> chunks(nchunks);
 
-      std::string err_mtl;
-      bool ok = readMatFn(namebuf, materials, material_map, err_mtl);
-      err += err_mtl;
-      
-      if (!ok) {
-        faceGroup.clear(); // for safety
-        return false;
-      }
+  const size_t nworkers = (num_threads < nchunks) ? num_threads : nchunks;
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < nworkers; t++) {
+    workers.push_back(
+        std::thread(parseChunks, &chunks, &bounds, t, nworkers));
+  }
+  parseChunks(&chunks, &bounds, 0, nworkers);
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
 
-      continue;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    if (!parser.replayChunk(chunks[i])) {
+      return false;
     }
+  }
 
-    // group name
-    if (token[0] == 'g' && isSpace((token[1]))) {
-
-      // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt,
-                                        faceGroup, material, name, true);
-      if (ret) {
-        shapes.push_back(shape);
-      }
-
-      shape = shape_t();
-
-      // material = -1;
-      faceGroup.clear();
-
-      std::vector<std::string> names;
-      while (!isNewLine(token[0])) {
-        std::string str = parseString(token);
-        names.push_back(str);
-        token += strspn(token, " \t\r"); // skip tag
-      }
+  return true;
+}
 
-      assert(names.size() > 0);
+bool LoadObj(std::vector<shape_t> &shapes, // [output]
+             std::vector<material_t> &materials, // [output]
+             std::string& err,
+             const char *buf, size_t len, MaterialReader &readMatFn,
+             int num_threads) {
+  obj_line_parser parser(shapes, materials, err, readMatFn);
 
-      // names[0] must be 'g', so skip the 0th element.
-      if (names.size() > 1) {
-        name = names[1];
-      } else {
-        name = "";
-      }
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
 
-      continue;
+  if (num_threads > 1) {
+    if (!LoadObjParallel(parser, buf, len,
+                         static_cast<unsigned int>(num_threads))) {
+      return false;
     }
+    parser.finish();
+    return true;
+  }
 
-    // object name
-    if (token[0] == 'o' && isSpace((token[1]))) {
-
-      // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt,
-                                        faceGroup, material, name, true);
-      if (ret) {
-        shapes.push_back(shape);
+  const char *line = buf;
+  const char *end = buf + len;
+  while (line < end) {
+    const char *eol = static_cast<const char *>(
+        memchr(line, '\n', static_cast<size_t>(end - line)));
+
+    if (!eol) {
+      // The last line has no terminating newline, so tokenizing it in place
+      // could read past the end of the buffer. Copy just this one line.
+      std::string linebuf(line, end);
+      if (!parser.parseLine(linebuf.c_str())) {
+        return false;
       }
-
-      // material = -1;
-      faceGroup.clear();
-      shape = shape_t();
-
-      // @todo { multiple object name? }
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 2;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
-      name = std::string(namebuf);
-
-      continue;
+      break;
     }
 
-    // Ignore unknown command.
+    if (!parser.parseLine(line)) {
+      return false;
+    }
+    line = eol + 1;
   }
 
-  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup,
-                                    material, name, true);
-  if (ret) {
-    shapes.push_back(shape);
-  }
-  faceGroup.clear(); // for safety
+  parser.finish();
 
-  err += errss.str();
   return true;
 }
 
@@ -126,6 +126,34 @@ bool LoadObj(std::vector<shape_t> &shapes,       // [output]
              std::string& err,                   // [output]
              std::istream &inStream, MaterialReader &readMatFn);
 
+/// Loads .obj from a memory buffer of `len` bytes. Lines are tokenized in
+/// place, so no per-line copies are made. `buf` does not need to be NUL
+/// terminated. Uses `readMatFn` to retrieve materials.
+/// 'num_threads' > 1 splits the buffer at line boundaries and parses the
+/// pieces in parallel (0 = one per hardware thread). The result is identical
+/// to a single-threaded parse. Small buffers are parsed on fewer threads.
+/// Returns true when loading .obj become success.
+/// Returns warning and error message into `err`
+bool LoadObj(std::vector<shape_t> &shapes,       // [output]
+             std::vector<material_t> &materials, // [output]
+             std::string& err,                   // [output]
+             const char *buf, size_t len, MaterialReader &readMatFn,
+             int num_threads = 1);
+
+/// Same as the filename based LoadObj(), but memory-maps the file and parses
+/// it directly from the mapping instead of reading it through std::ifstream.
+/// See above for 'num_threads'.
+bool LoadObjMapped(std::vector<shape_t> &shapes,       // [output]
+                   std::vector<material_t> &materials, // [output]
+                   std::string& err,                   // [output]
+                   const char *filename, const char *mtl_basepath = NULL,
+                   int num_threads = 1);
+
+/// Parses the number at the start of [s, s_end) the way every float in
+/// .obj and .mtl files is parsed: greedily, correctly rounded and without
+/// depending on the locale. Returns false if there is no number.
+bool ParseDouble(const char *s, const char *s_end, double *result);
+
 /// Loads materials into std::map
 void LoadMtl(std::map<std::string, int> &material_map, // [output]
              std::vector<material_t> &materials,       // [output]